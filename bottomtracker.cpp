@@ -0,0 +1,423 @@
+#include "bottomtracker.h"
+#include "productcache.h"
+#include <QString>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QPair>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+const int ZeroRunWindow = 50;       // 判断零值区/回波区的窗口
+const int FirstPingWindow = 100;    // 第一个 ping 暗区均值窗口
+const int RecheckWindow = 120;      // 跳变过大时重新搜索的窗口
+const double PortStartRatio = 0.7;  // 左舷从 70% 处开始找
+const double StarboardEndRatio = 0.4;   // 右舷只在前 40% 内找
+
+// 算法有改动时加一，旧的缓存结果随之失效
+const int TrackerVersion = 1;
+
+// 高度引导的卡尔曼滤波参数，单位为样点
+const double PositionNoise = 4.0;       // 过程噪声：位置
+const double VelocityNoise = 0.25;      // 过程噪声：每 ping 的变化率
+const double AltitudeNoise = 100.0;     // 高度计换算结果的测量噪声（约 10 个样点）
+const double EdgeNoise = 9.0;           // 样本中找到的边缘的测量噪声（约 3 个样点）
+
+// 位置 + 每 ping 变化率的常速度模型
+struct TrackFilter {
+    bool valid = false;
+    double pos = 0.0, vel = 0.0;
+    double p00 = 0.0, p01 = 0.0, p11 = 0.0;    // 协方差
+
+    void reset(double z, double variance)
+    {
+        valid = true;
+        pos = z;
+        vel = 0.0;
+        p00 = variance;
+        p01 = 0.0;
+        p11 = 1.0;
+    }
+
+    void predict()
+    {
+        pos += vel;
+        p00 += 2 * p01 + p11 + PositionNoise;
+        p01 += p11;
+        p11 += VelocityNoise;
+    }
+
+    void update(double z, double r)
+    {
+        const double s = p00 + r;
+        const double k0 = p00 / s;
+        const double k1 = p01 / s;
+        const double innovation = z - pos;
+        pos += k0 * innovation;
+        vel += k1 * innovation;
+        p11 -= k1 * p01;
+        p01 -= k1 * p00;
+        p00 -= k0 * p00;
+    }
+};
+
+// prefix[i] 为前 i 个样本的和
+void buildPrefix(const uint8_t* samples, int count, std::vector<int>& prefix)
+{
+    prefix.resize(static_cast<size_t>(count) + 1);
+    prefix[0] = 0;
+    for (int i = 0; i < count; ++i) {
+        prefix[i + 1] = prefix[i] + samples[i];
+    }
+}
+
+// counts[i] 为前 i 个样本中满足条件的个数
+template <typename Pred>
+void buildCount(const uint8_t* samples, int count, std::vector<int>& counts, Pred pred)
+{
+    counts.resize(static_cast<size_t>(count) + 1);
+    counts[0] = 0;
+    for (int i = 0; i < count; ++i) {
+        counts[i + 1] = counts[i] + (pred(samples[i]) ? 1 : 0);
+    }
+}
+
+// 按 ping 切块并行
+template <typename Op>
+void forEachPingRange(int pingCount, Op op)
+{
+    QVector<QPair<int, int>> ranges;
+    const int chunkCount = QThreadPool::globalInstance()->maxThreadCount() * 4;
+    const int chunkSize = qMax(1, (pingCount + chunkCount - 1) / chunkCount);
+    for (int begin = 0; begin < pingCount; begin += chunkSize) {
+        ranges.append(qMakePair(begin, qMin(pingCount, begin + chunkSize)));
+    }
+    if (ranges.size() > 1) {
+        QtConcurrent::blockingMap(ranges, op);
+    } else if (!ranges.isEmpty()) {
+        op(ranges.first());
+    }
+}
+
+}
+
+BottomTracker::BottomTracker()
+{
+}
+
+void BottomTracker::clear()
+{
+    altitudeUsed = false;
+    portRaw.clear();
+    starboardRaw.clear();
+    portSmoothed.clear();
+    starboardSmoothed.clear();
+}
+
+void BottomTracker::track(const PingMatrix &port, const PingMatrix &starboard, const PingMetaTable &meta)
+{
+    clear();
+
+    // 至少一半 ping 有有效高度时才用高度引导
+    int validAltitudes = 0;
+    if (trackMode == AltitudeSeeded) {
+        for (int ping = 0; ping < meta.size(); ++ping) {
+            if (expectedFirstReturn(meta, ping) >= 0) ++validAltitudes;
+        }
+    }
+    const int pings = qMax(port.rows(), starboard.rows());
+    altitudeUsed = trackMode == AltitudeSeeded && meta.size() >= pings && validAltitudes * 2 >= pings;
+
+    if (altitudeUsed) {
+        portRaw = trackSeeded(port, meta, true);
+        starboardRaw = trackSeeded(starboard, meta, false);
+    } else {
+        trackThreshold(port, starboard);
+    }
+
+    // 平滑
+    portSmoothed = smoothWindow > 0 ? smoothLine(portRaw, smoothWindow) : portRaw;
+    starboardSmoothed = smoothWindow > 0 ? smoothLine(starboardRaw, smoothWindow) : starboardRaw;
+}
+
+bool BottomTracker::trackCached(const PingMatrix &port, const PingMatrix &starboard,
+                                const PingMetaTable &meta, const ProductCache &cache)
+{
+    const QByteArray params = parameterKey();
+    QVector<QVector<int>> lines;
+    if (cache.loadLines("bottomtrack", params, lines) && lines.size() == 5
+        && lines[0].size() == port.rows() && lines[1].size() == starboard.rows()) {
+        portRaw = lines[0];
+        starboardRaw = lines[1];
+        portSmoothed = lines[2];
+        starboardSmoothed = lines[3];
+        altitudeUsed = !lines[4].isEmpty() && lines[4][0] != 0;
+        return true;
+    }
+
+    track(port, starboard, meta);
+    lines = {portRaw, starboardRaw, portSmoothed, starboardSmoothed, QVector<int>{altitudeUsed ? 1 : 0}};
+    cache.saveLines("bottomtrack", params, lines);
+    return false;
+}
+
+QByteArray BottomTracker::parameterKey() const
+{
+    return QStringLiteral("v%1;mode=%2;smooth=%3;jump=%4;half=%5")
+        .arg(TrackerVersion).arg(trackMode).arg(smoothWindow).arg(maxJump).arg(minHalfWidth).toLatin1();
+}
+
+int BottomTracker::expectedFirstReturn(const PingMeta &meta)
+{
+    const double metersPerSample = meta.metersPerSample();
+    if (meta.altitude <= 0.0 || metersPerSample <= 0.0) return -1;
+
+    const double sample = meta.altitude / metersPerSample;
+    if (meta.numSamples > 0 && sample >= meta.numSamples) return -1;
+    return static_cast<int>(std::lround(sample));
+}
+
+int BottomTracker::expectedFirstReturn(const PingMetaTable &meta, int ping)
+{
+    const double altitude = meta.altitude()[ping];
+    const double metersPerSample = meta.metersPerSample(ping);
+    if (altitude <= 0.0 || metersPerSample <= 0.0) return -1;
+
+    const double sample = altitude / metersPerSample;
+    const int numSamples = meta.numSamples()[ping];
+    if (numSamples > 0 && sample >= numSamples) return -1;
+    return static_cast<int>(std::lround(sample));
+}
+
+QVector<int> BottomTracker::trackSeeded(const PingMatrix &data, const PingMetaTable &meta, bool nadirAtEnd) const
+{
+    QVector<int> line(data.rows());
+    TrackFilter filter;
+    std::vector<int> counts;
+
+    for (int ping = 0; ping < data.rows(); ++ping) {
+        const uint8_t* samples = data.row(ping);
+        const int sampleCount = data.rowSize(ping);
+        if (sampleCount <= 0) {
+            line[ping] = 0;
+            continue;
+        }
+
+        // 按距正下方的样点数跟踪，左右舷换算方式相同
+        const int expected = expectedFirstReturn(meta, ping);
+        if (filter.valid) filter.predict();
+        if (expected >= 0) {
+            if (filter.valid) filter.update(expected, AltitudeNoise);
+            else filter.reset(expected, AltitudeNoise);
+        }
+        if (!filter.valid) {
+            line[ping] = nadirAtEnd ? sampleCount - 1 : 0;
+            continue;
+        }
+
+        // 窄窗口内找离预测最近的边缘：左舷为零值区起点，右舷为回波区起点
+        const int halfWidth = qBound(minHalfWidth, static_cast<int>(3 * std::sqrt(filter.p00)), qMax(minHalfWidth, maxJump));
+        const int center = qBound(0, static_cast<int>(std::lround(filter.pos)), sampleCount - 1);
+        const int centerIdx = nadirAtEnd ? sampleCount - center : center;
+        const int lo = qMax(0, centerIdx - halfWidth);
+        const int hi = qMin(sampleCount - 1, centerIdx + halfWidth);
+        const int countBegin = qMax(0, lo - 1);
+        const int countEnd = qMin(sampleCount, hi + ZeroRunWindow);
+
+        // 只统计窗口附近的样本，counts[i - countBegin] 为 [countBegin, i) 内命中的个数
+        counts.resize(static_cast<size_t>(countEnd - countBegin) + 1);
+        counts[0] = 0;
+        for (int i = countBegin; i < countEnd; ++i) {
+            const bool hit = nadirAtEnd ? samples[i] == 0 : samples[i] > 0;
+            counts[i - countBegin + 1] = counts[i - countBegin] + (hit ? 1 : 0);
+        }
+        auto inRun = [&](int i) {
+            const bool hit = nadirAtEnd ? samples[i] == 0 : samples[i] > 0;
+            const int checkRange = std::min(ZeroRunWindow, countEnd - i);
+            return hit && counts[i - countBegin + checkRange] - counts[i - countBegin] > checkRange * 0.9;
+        };
+
+        // 区段的起点才算边缘，窗口左端之前已在区内的不算
+        int edge = -1;
+        bool prevInRun = lo > 0 && inRun(lo - 1);
+        for (int i = lo; i <= hi; ++i) {
+            const bool cur = inRun(i);
+            if (cur && !prevInRun && (edge < 0 || std::abs(i - centerIdx) < std::abs(edge - centerIdx))) edge = i;
+            prevInRun = cur;
+        }
+
+        if (edge >= 0) {
+            filter.update(nadirAtEnd ? sampleCount - edge : edge, EdgeNoise);
+        }
+        const int fromNadir = qBound(0, static_cast<int>(std::lround(filter.pos)), sampleCount - 1);
+        line[ping] = nadirAtEnd ? qBound(0, sampleCount - fromNadir, sampleCount - 1) : fromNadir;
+    }
+    return line;
+}
+
+void BottomTracker::trackThreshold(const PingMatrix &port, const PingMatrix &starboard)
+{
+    // ---- 左舷：第一遍各 ping 独立搜索 ----
+    const int portPings = port.rows();
+    QVector<PortCandidate> candidates(portPings);
+    forEachPingRange(portPings, [&](const QPair<int, int>& range) {
+        std::vector<int> prefix, zeros;
+        for (int ping = range.first; ping < range.second; ++ping) {
+            candidates[ping] = searchPort(port.row(ping), port.rowSize(ping), ping == 0, prefix, zeros);
+        }
+    });
+
+    // ---- 左舷：第二遍按顺序施加连续性约束 ----
+    portRaw.resize(portPings);
+    std::vector<int> prefix;
+    int prevIdx = -1;
+    for (int ping = 0; ping < portPings; ++ping) {
+        const uint8_t* samples = port.row(ping);
+        const int sampleCount = port.rowSize(ping);
+        int idx = candidates[ping].idx;
+
+        if (ping > 0 && (idx == -1 || std::abs(idx - prevIdx) > maxJump)) {
+            int minPos = std::min(idx, prevIdx);
+            if (minPos >= candidates[ping].startIdx) minPos = candidates[ping].startIdx;
+            const int maxPos = std::max(idx, prevIdx);
+            const int candidate = searchDarkest(samples, sampleCount, minPos, maxPos,
+                                                RecheckWindow, false, prefix);
+            if (candidate != -1) idx = candidate;
+        }
+        if (idx < 0) idx = sampleCount - 1;
+        portRaw[ping] = idx;
+        prevIdx = idx;
+    }
+
+    // ---- 右舷：各 ping 互不依赖 ----
+    const int starboardPings = starboard.rows();
+    starboardRaw.resize(starboardPings);
+    forEachPingRange(starboardPings, [&](const QPair<int, int>& range) {
+        std::vector<int> nonZeros;
+        for (int ping = range.first; ping < range.second; ++ping) {
+            starboardRaw[ping] = searchStarboard(starboard.row(ping), starboard.rowSize(ping), nonZeros);
+        }
+    });
+}
+
+BottomTracker::PortCandidate BottomTracker::searchPort(const uint8_t *samples, int sampleCount, bool firstPing,
+                                                       std::vector<int> &prefix, std::vector<int> &zeros) const
+{
+    PortCandidate result;
+    const int customStartIdx = static_cast<int>(sampleCount * PortStartRatio);
+    result.startIdx = findAppropriateStartIdx(samples, sampleCount, customStartIdx);
+    if (sampleCount <= 0) return result;
+
+    // 零值区：从起点往后第一个 90% 以上为 0 的窗口
+    buildCount(samples, sampleCount, zeros, [](uint8_t v) { return v == 0; });
+    for (int i = qMax(0, result.startIdx); i < sampleCount; ++i) {
+        if (samples[i] != 0) continue;
+        const int checkRange = std::min(ZeroRunWindow, sampleCount - i);
+        if (zeros[i + checkRange] - zeros[i] > checkRange * 0.9) {
+            result.idx = i;
+            break;
+        }
+    }
+
+    // 第一个 ping 没有前一个 ping 可参考，在后面找窗口均值最小的暗区
+    if (firstPing) {
+        if (result.idx == -1) result.idx = customStartIdx;
+        const int candidate = searchDarkest(samples, sampleCount, result.idx, sampleCount - 1,
+                                            FirstPingWindow, true, prefix);
+        if (candidate != -1) result.idx = candidate;
+    }
+    return result;
+}
+
+int BottomTracker::searchStarboard(const uint8_t *samples, int sampleCount, std::vector<int> &nonZeros) const
+{
+    // 回波区：前 40% 内第一个 90% 以上非 0 的窗口
+    const double end = sampleCount * StarboardEndRatio;
+    const int limit = static_cast<int>(end);
+    buildCount(samples, sampleCount, nonZeros, [](uint8_t v) { return v > 0; });
+    for (int i = 0; i < end && i < sampleCount; ++i) {
+        if (samples[i] == 0) continue;
+        const int checkRange = std::min(ZeroRunWindow, limit - i);
+        if (checkRange > 0 && nonZeros[i + checkRange] - nonZeros[i] > checkRange * 0.9) return i;
+    }
+    return 0;
+}
+
+int BottomTracker::searchDarkest(const uint8_t *samples, int sampleCount, int minPos, int maxPos,
+                                 int window, bool requirePositive, std::vector<int> &prefix)
+{
+    minPos = std::max(0, minPos);
+    maxPos = std::min(sampleCount - 1, maxPos);
+    if (minPos > maxPos) return -1;
+
+    buildPrefix(samples, sampleCount, prefix);
+    int candidate = -1;
+    int bestMean = INT_MAX;
+    for (int i = minPos; i <= maxPos; ++i) {
+        if (samples[i] > 3) continue;
+        const int end = std::min(sampleCount, i + window);
+        const int localMean = (prefix[end] - prefix[i]) / std::max(1, end - i);
+        if (localMean > 5 || (requirePositive && localMean <= 0)) continue;
+        if (localMean <= bestMean) {     // 均值相同时取靠后的位置
+            bestMean = localMean;
+            candidate = i;
+        }
+    }
+    return candidate;
+}
+
+QVector<int> BottomTracker::smoothLine(const QVector<int> &line, int window)
+{
+    const int n = line.size();
+    std::vector<qint64> prefix(static_cast<size_t>(n) + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        prefix[i + 1] = prefix[i] + line[i];
+    }
+
+    QVector<int> smoothed(n);
+    for (int i = 0; i < n; ++i) {
+        const int first = std::max(0, i - window);
+        const int last = std::min(i + window, n - 1);
+        smoothed[i] = static_cast<int>((prefix[last + 1] - prefix[first]) / (last - first + 1));
+    }
+    return smoothed;
+}
+
+int BottomTracker::findAppropriateStartIdx(const uint8_t *samples, int sampleCount, int startIdx)
+{
+    if (sampleCount <= 0) return -1;
+
+    int idx = startIdx;
+    if(startIdx == 0) return idx;
+    // 如果当前位置强度值过小，则尝试往前寻找更合适的点
+    if (samples[startIdx] == 0 || samples[startIdx-1] == 0) {
+        int candidate = -1;
+
+        // 1. 优先往前找第一个不为0的点
+        for (int i = startIdx; i >= 0; --i) {
+            if (samples[i] >= 3) {
+                candidate = i+1;
+                break;
+            }
+        }
+
+        // 2. 如果没有严格为0的点，找一个接近0的点（阈值 >=5）
+        if (candidate == -1) {
+            for (int i = startIdx; i >= 0; --i) {
+                if (samples[i] >= 5) {
+                    candidate = i+1;
+                    break;
+                }
+            }
+        }
+
+        if (candidate != -1) {
+            idx = candidate;
+        }
+    }
+
+    return idx;
+}
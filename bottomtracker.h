@@ -0,0 +1,94 @@
+#ifndef BOTTOMTRACKER_H
+#define BOTTOMTRACKER_H
+
+#include <QVector>
+#include <cstdint>
+#include <vector>
+#include "pingmatrix.h"
+#include "pingmeta.h"
+
+class ProductCache;
+
+// 底部（水线）追踪：在左右舷 8 位样本中找第一回波位置（左舷行尾、右舷行首为正下方）。
+// 阈值搜索：窗口统计都用前缀和，每个 ping 只扫描常数遍；各 ping 先并行独立搜索，
+// 再按顺序施加相邻 ping 的连续性约束，只有跳变过大的 ping 需要再扫一遍。
+// 高度引导：用高度计读数、声速和采样间隔换算预期的第一回波样点，结合上一 ping 的
+// 预测（卡尔曼滤波）只在很窄的窗口内找边缘
+class BottomTracker
+{
+public:
+    enum Mode {
+        ThresholdSearch,    // 从固定比例处搜索整行
+        AltitudeSeeded      // 高度计引导的窄窗口搜索，高度数据不足时退回阈值搜索
+    };
+
+    BottomTracker();
+
+    void setMode(Mode m) { trackMode = m; }
+    Mode mode() const { return trackMode; }
+    // 高度引导时的最小搜索半宽（样点数），实际半宽随预测不确定度增大，不超过 maxJump
+    void setSearchHalfWidth(int samples) { minHalfWidth = samples; }
+
+    // 平滑窗口（前后各 window 个 ping），<= 0 不平滑
+    void setSmoothWindow(int window) { smoothWindow = window; }
+    // 相邻 ping 允许的最大跳变（样本数），超过时在两者之间重新搜索
+    void setMaxJump(int jump) { maxJump = jump; }
+
+    // meta 与 ping 序号对齐，只在 AltitudeSeeded 模式下使用
+    void track(const PingMatrix& port, const PingMatrix& starboard,
+               const PingMetaTable& meta = PingMetaTable());
+    // 先从产品缓存读取，参数相同的结果不存在时再追踪并写回缓存。返回 true 表示命中缓存
+    bool trackCached(const PingMatrix& port, const PingMatrix& starboard,
+                     const PingMetaTable& meta, const ProductCache& cache);
+    void clear();
+    // 影响追踪结果的全部参数，用作缓存的键
+    QByteArray parameterKey() const;
+    // 上一次 track() 是否用了高度引导
+    bool usedAltitude() const { return altitudeUsed; }
+
+    // 高度换算成第一回波距正下方的样点数，参数无效时返回 -1
+    static int expectedFirstReturn(const PingMeta& meta);
+    // 同上，直接读参数表的列
+    static int expectedFirstReturn(const PingMetaTable& meta, int ping);
+
+    // 平滑后的水线，每个 ping 一个样本序号
+    const QVector<int>& portLine() const { return portSmoothed; }
+    const QVector<int>& starboardLine() const { return starboardSmoothed; }
+    // 未平滑的水线
+    const QVector<int>& portRawLine() const { return portRaw; }
+    const QVector<int>& starboardRawLine() const { return starboardRaw; }
+
+    // 移动平均平滑，前缀和实现，与窗口大小无关
+    static QVector<int> smoothLine(const QVector<int>& line, int window);
+    // 起始位置落在零值区时往前找到回波边缘
+    static int findAppropriateStartIdx(const uint8_t* samples, int sampleCount, int startIdx);
+
+private:
+    void trackThreshold(const PingMatrix& port, const PingMatrix& starboard);
+    // 高度引导追踪一舷，nadirAtEnd 为 true 时正下方在行尾（左舷）
+    QVector<int> trackSeeded(const PingMatrix& data, const PingMetaTable& meta, bool nadirAtEnd) const;
+
+    // 第一遍的结果，各 ping 互不依赖
+    struct PortCandidate {
+        int startIdx = -1;      // 搜索起点
+        int idx = -1;           // 零值区起点
+    };
+
+    PortCandidate searchPort(const uint8_t* samples, int sampleCount, bool firstPing,
+                             std::vector<int>& prefix, std::vector<int>& zeros) const;
+    int searchStarboard(const uint8_t* samples, int sampleCount, std::vector<int>& nonZeros) const;
+    // 在 [minPos, maxPos] 内找窗口均值最小的暗区，找不到返回 -1
+    static int searchDarkest(const uint8_t* samples, int sampleCount, int minPos, int maxPos,
+                             int window, bool requirePositive, std::vector<int>& prefix);
+
+    Mode trackMode = ThresholdSearch;
+    int smoothWindow = 100;
+    int maxJump = 150;
+    int minHalfWidth = 40;
+    bool altitudeUsed = false;
+
+    QVector<int> portRaw, starboardRaw;
+    QVector<int> portSmoothed, starboardSmoothed;
+};
+
+#endif // BOTTOMTRACKER_H
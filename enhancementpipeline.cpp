@@ -0,0 +1,106 @@
+#include "enhancementpipeline.h"
+#include "sonogramgenerator.h"
+#include <algorithm>
+
+EnhancementPipeline::EnhancementPipeline()
+{
+}
+
+EnhancementPipeline &EnhancementPipeline::addGamma(double gamma)
+{
+    operations.append({Gamma, gamma});
+    return *this;
+}
+
+EnhancementPipeline &EnhancementPipeline::addEqualize()
+{
+    operations.append({Equalize, 1.0});
+    return *this;
+}
+
+EnhancementPipeline &EnhancementPipeline::addNormalize()
+{
+    operations.append({Normalize, 1.0});
+    return *this;
+}
+
+EnhancementPipeline &EnhancementPipeline::addStretch()
+{
+    operations.append({Stretch, 1.0});
+    return *this;
+}
+
+EnhancementPipeline &EnhancementPipeline::addNegative()
+{
+    operations.append({Negative, 1.0});
+    return *this;
+}
+
+bool EnhancementPipeline::needsHistogram() const
+{
+    for (const Step& step : operations) {
+        if (step.op == Equalize || step.op == Normalize || step.op == Stretch) return true;
+    }
+    return false;
+}
+
+void EnhancementPipeline::buildLut(const qint64 *sourceHist, uchar lut[256]) const
+{
+    SonogramGenerator::identityLut(lut);
+
+    for (const Step& step : operations) {
+        uchar next[256];
+        if (step.op == Gamma) {
+            SonogramGenerator::gammaLut(step.gamma, next);
+        } else if (step.op == Negative) {
+            SonogramGenerator::negativeLut(next);
+        } else {
+            if (!sourceHist) continue;
+
+            // 前面的操作作用后的直方图，不再访问像素
+            qint64 hist[256] = {0};
+            for (int v = 0; v < 256; ++v) {
+                hist[lut[v]] += sourceHist[v];
+            }
+
+            if (step.op == Equalize) {
+                SonogramGenerator::equalizationLut(hist, next);
+            } else {
+                int minVal, maxVal;
+                if (!SonogramGenerator::histogramRange(hist, minVal, maxVal)) continue;   // 所有像素相同，保持不变
+                if (step.op == Normalize)
+                    SonogramGenerator::normalizeLut(minVal, maxVal, next);
+                else
+                    SonogramGenerator::stretchLut(minVal, maxVal, next);
+            }
+        }
+
+        for (int i = 0; i < 256; ++i) {
+            lut[i] = next[lut[i]];
+        }
+    }
+}
+
+QImage EnhancementPipeline::apply(const QImage &src) const
+{
+    if (src.isNull()) return QImage();
+
+    const QImage gray = src.convertToFormat(QImage::Format_Grayscale8);
+    qint64 hist[256] = {0};
+    if (needsHistogram()) SonogramGenerator::accumulateHistogram(gray, hist);
+
+    uchar lut[256];
+    buildLut(hist, lut);
+    return SonogramGenerator::applyLut(gray, lut);
+}
+
+TiledImage EnhancementPipeline::apply(const TiledImage &src) const
+{
+    // 直方图统计整幅图，而不是每个条带各自统计
+    qint64 hist[256] = {0};
+    if (needsHistogram()) SonogramGenerator::accumulateHistogram(src, hist);
+
+    uchar lut[256];
+    buildLut(hist, lut);
+    return SonogramGenerator::applyLut(src, lut);
+}
@@ -0,0 +1,53 @@
+#ifndef ENHANCEMENTPIPELINE_H
+#define ENHANCEMENTPIPELINE_H
+
+#include <QImage>
+#include <QVector>
+#include "tiledimage.h"
+
+// 灰度增强流水线：按顺序记录增强操作。这些操作都是逐点灰度映射，
+// 复合成一张 256 项查找表后只处理一遍像素；需要的统计量（直方图、最小/最大值）
+// 只在处理前统计一次原图，后续操作的统计量由前面的查找表映射直方图得到
+class EnhancementPipeline
+{
+public:
+    enum Operation {
+        Gamma,
+        Equalize,       // 直方图均衡化
+        Normalize,      // 归一化
+        Stretch,        // 强度拉伸
+        Negative        // 负片
+    };
+
+    struct Step {
+        Operation op;
+        double gamma;   // 只有 Gamma 使用
+    };
+
+    EnhancementPipeline();
+
+    void clear() { operations.clear(); }
+    bool isEmpty() const { return operations.isEmpty(); }
+    const QVector<Step>& steps() const { return operations; }
+
+    EnhancementPipeline& addGamma(double gamma);
+    EnhancementPipeline& addEqualize();
+    EnhancementPipeline& addNormalize();
+    EnhancementPipeline& addStretch();
+    EnhancementPipeline& addNegative();
+
+    // 是否有依赖图像统计量的操作
+    bool needsHistogram() const;
+
+    // 复合出整条流水线的查找表。sourceHist 为原图直方图，needsHistogram() 为 false 时可以传 nullptr
+    void buildLut(const qint64* sourceHist, uchar lut[256]) const;
+
+    // 统计一次直方图（需要时）后一遍查表处理
+    QImage apply(const QImage& src) const;
+    TiledImage apply(const TiledImage& src) const;
+
+private:
+    QVector<Step> operations;
+};
+
+#endif // ENHANCEMENTPIPELINE_H
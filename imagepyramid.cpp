@@ -0,0 +1,218 @@
+#include "imagepyramid.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <QtConcurrent>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// 第 level 层的尺寸：每层宽高减半并向上取整
+int widthAt(int width, int level)
+{
+    for (int i = 0; i < level; ++i) width = (width + 1) / 2;
+    return width;
+}
+
+qint64 rowsAt(qint64 rows, int level)
+{
+    for (int i = 0; i < level; ++i) rows = (rows + 1) / 2;
+    return rows;
+}
+
+// 2×2 降采样，dst 的宽高为 src 的一半（向上取整）
+void halveInto(const QImage& src, QImage& dst, DownsampleMethod method)
+{
+    const int width = dst.width();
+    const int srcWidth = src.width();
+    const int srcHeight = src.height();
+    for (int y = 0; y < dst.height(); ++y) {
+        const uchar* top = src.constScanLine(2 * y);
+        const uchar* bottom = src.constScanLine(qMin(2 * y + 1, srcHeight - 1));
+        uchar* out = dst.scanLine(y);
+        for (int x = 0; x < width; ++x) {
+            const int x1 = qMin(2 * x + 1, srcWidth - 1);
+            // 反色灰度：灰度越小回波越强
+            const int a = 255 - top[2 * x], b = 255 - top[x1];
+            const int c = 255 - bottom[2 * x], d = 255 - bottom[x1];
+            int echo;
+            if (method == DOWNSAMPLE_RMS) {
+                echo = qRound(std::sqrt((a * a + b * b + c * c + d * d) / 4.0));
+            } else {
+                echo = qMax(qMax(a, b), qMax(c, d));
+            }
+            // 四个都是补白时仍为补白，否则保持为数据像素
+            const bool padding = (top[2 * x] & top[x1] & bottom[2 * x] & bottom[x1]) == TiledImage::PaddingGray;
+            out[x] = padding ? TiledImage::PaddingGray : static_cast<uchar>(qMin(255 - echo, static_cast<int>(TiledImage::MaxDataGray)));
+        }
+    }
+}
+
+} // namespace
+
+ImagePyramid::ImagePyramid(DownsampleMethod method, QObject *parent)
+    : QObject(parent)
+    , downsample(method)
+    , state(new State)
+{
+    state->method = method;
+    // 后台生成只用少量线程，不和界面线程的绘制抢全局线程池
+    builders.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+ImagePyramid::~ImagePyramid()
+{
+    cancelBuilds();
+}
+
+void ImagePyramid::cancelBuilds()
+{
+    // 排队的任务直接丢弃，正在执行的任务看到取消标志后尽快返回；等它们结束之后才能析构
+    state->cancelled.storeRelease(1);
+    {
+        QMutexLocker locker(&state->mutex);
+        state->built.wakeAll();
+    }
+    builders.clear();
+    builders.waitForDone();
+}
+
+void ImagePyramid::setImage(const TiledImage &image)
+{
+    cancelBuilds();
+    source = image;
+    state.reset(new State);
+    state->source = image;
+    state->method = downsample;
+}
+
+int ImagePyramid::levelCount() const
+{
+    int count = 1;
+    for (int width = source.width(); width > 1 && count < MaxLevels; width = (width + 1) / 2) {
+        ++count;
+    }
+    return count;
+}
+
+int ImagePyramid::levelForScale(qreal scale) const
+{
+    if (scale <= 0.0 || scale >= 1.0) return 0;
+    // 缩小到一半以下才换下一层，保证使用的层分辨率不低于屏幕
+    const int level = static_cast<int>(std::floor(std::log2(1.0 / scale)));
+    return qBound(0, level, levelCount() - 1);
+}
+
+int ImagePyramid::levelWidth(int level) const
+{
+    return widthAt(source.width(), level);
+}
+
+qint64 ImagePyramid::levelRows(int level) const
+{
+    return rowsAt(source.height(), level);
+}
+
+quint64 ImagePyramid::tileKey(int level, int tx, int ty)
+{
+    return (static_cast<quint64>(level) << 56) | (static_cast<quint64>(tx) << 32) | static_cast<quint32>(ty);
+}
+
+QImage ImagePyramid::tile(int level, int tx, int ty)
+{
+    if (level <= 0 || level >= levelCount() || source.isEmpty()) return QImage();
+    if (tx < 0 || ty < 0 || static_cast<qint64>(tx) * TileSize >= levelWidth(level)
+        || static_cast<qint64>(ty) * TileSize >= levelRows(level)) return QImage();
+
+    const quint64 key = tileKey(level, tx, ty);
+    {
+        QMutexLocker locker(&state->mutex);
+        auto it = state->tiles.constFind(key);
+        if (it != state->tiles.constEnd()) return it.value();
+        if (state->pending.contains(key)) return QImage();
+        state->pending.insert(key);
+    }
+
+    QSharedPointer<State> target = state;
+    QtConcurrent::run(&builders, [this, target, key, level, tx, ty]() {
+        const QImage result = target->cancelled.loadAcquire() ? QImage() : buildTile(*target, level, tx, ty);
+        {
+            // 无论生成成功与否都要出队，否则这一块再也不会被请求
+            QMutexLocker locker(&target->mutex);
+            target->pending.remove(key);
+        }
+        if (!result.isNull() && !target->cancelled.loadAcquire()) emit tilesReady();
+    });
+    return QImage();
+}
+
+QImage ImagePyramid::buildTile(State &state, int level, int tx, int ty)
+{
+    const quint64 key = tileKey(level, tx, ty);
+    {
+        QMutexLocker locker(&state.mutex);
+        // 相邻的上层块共用下一层块时只生成一次；等待的总是更低一层的块，不会互相等待
+        while (state.building.contains(key) && !state.cancelled.loadAcquire()) state.built.wait(&state.mutex);
+        auto it = state.tiles.constFind(key);
+        if (it != state.tiles.constEnd()) return it.value();
+        if (state.cancelled.loadAcquire()) return QImage();
+        state.building.insert(key);
+    }
+
+    const QImage result = generateTile(state, level, tx, ty);
+
+    QMutexLocker locker(&state.mutex);
+    state.building.remove(key);
+    if (!result.isNull()) state.tiles.insert(key, result);
+    state.built.wakeAll();
+    return result;
+}
+
+QImage ImagePyramid::generateTile(State &state, int level, int tx, int ty)
+{
+    // 上一层对应的 2×2 块（第 1 层直接取原图）拼成一块再降采样
+    const int parentWidth = widthAt(state.source.width(), level - 1);
+    const qint64 parentRows = rowsAt(state.source.height(), level - 1);
+    const int x0 = 2 * tx * TileSize;
+    const qint64 y0 = 2 * static_cast<qint64>(ty) * TileSize;
+    const int w = qMin<qint64>(2 * TileSize, parentWidth - x0);
+    const int h = static_cast<int>(qMin<qint64>(2 * TileSize, parentRows - y0));
+    if (w <= 0 || h <= 0) return QImage();
+
+    QImage region(w, h, QImage::Format_Grayscale8);
+    region.fill(Qt::white);
+    if (level == 1) {
+        const TiledImage& image = state.source;
+        int stripIndex = -1;
+        QImage strip;
+        for (int y = 0; y < h; ++y) {
+            const qint64 row = y0 + y;
+            const int i = image.tileAt(row);
+            if (i != stripIndex) {
+                stripIndex = i;
+                strip = image.tile(i);
+                if (strip.format() != QImage::Format_Grayscale8) strip = strip.convertToFormat(QImage::Format_Grayscale8);
+            }
+            const int available = qMin(w, strip.width() - x0);   // 条带可能比整幅图窄，其余保持白色
+            if (available > 0) {
+                std::memcpy(region.scanLine(y), strip.constScanLine(static_cast<int>(row - image.tileTop(i))) + x0, available);
+            }
+        }
+    } else {
+        for (int dy = 0; dy < 2; ++dy) {
+            for (int dx = 0; dx < 2; ++dx) {
+                if (dx * TileSize >= w || dy * TileSize >= h) continue;
+                if (state.cancelled.loadAcquire()) return QImage();
+                const QImage child = buildTile(state, level - 1, 2 * tx + dx, 2 * ty + dy);
+                for (int y = 0; y < child.height(); ++y) {
+                    std::memcpy(region.scanLine(dy * TileSize + y) + dx * TileSize, child.constScanLine(y), child.width());
+                }
+            }
+        }
+        if (state.cancelled.loadAcquire()) return QImage();
+    }
+
+    QImage result((w + 1) / 2, (h + 1) / 2, QImage::Format_Grayscale8);
+    halveInto(region, result, state.method);
+    return result;
+}
@@ -0,0 +1,76 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include "tiledimage.h"
+#include "xtf.h"
+
+// TiledImage 的多分辨率金字塔：第 0 层为原图（直接取原图条带），第 L 层由第 L-1 层 2×2 降采样得到，
+// 按 TileSize × TileSize 的小块存放。某一块第一次被访问时放到后台线程生成（缺少的下一层块一并生成），
+// 生成前 tile() 返回空图，由调用者先用原图代替，生成后发出 tilesReady()。
+// 声图按反色存放（255 为无回波），降采样按回波强度 255-灰度 取最大值或均方根，与 DownsampleMethod 一致
+class ImagePyramid : public QObject
+{
+    Q_OBJECT
+public:
+    static const int TileSize = 256;
+    static const int MaxLevels = 16;
+
+    explicit ImagePyramid(DownsampleMethod method = DOWNSAMPLE_MAX, QObject* parent = nullptr);
+    ~ImagePyramid();
+
+    DownsampleMethod method() const { return downsample; }
+
+    // 重新设置原图，已生成的块全部丢弃，正在生成的块作废
+    void setImage(const TiledImage& image);
+    const TiledImage& image() const { return source; }
+
+    // 层数：缩到宽度为 1 像素为止
+    int levelCount() const;
+    // 每个图像像素显示为 scale 个屏幕像素时应使用的层（比例越小层越高）
+    int levelForScale(qreal scale) const;
+    // 第 level 层的宽度和行数（向上取整）
+    int levelWidth(int level) const;
+    qint64 levelRows(int level) const;
+
+    // 第 level (>= 1) 层第 ty 行、第 tx 列的块，还没生成时返回空图并在后台生成
+    QImage tile(int level, int tx, int ty);
+
+signals:
+    // 后台生成了新的块，可在任意线程发出
+    void tilesReady();
+
+private:
+    // 一张原图对应的全部块，后台任务持有自己的引用，换图后旧任务只写旧状态
+    struct State {
+        TiledImage source;
+        DownsampleMethod method = DOWNSAMPLE_MAX;
+        QMutex mutex;
+        QHash<quint64, QImage> tiles;
+        QSet<quint64> pending;              // tile() 已排队、任务还没结束的块，避免重复排队
+        QSet<quint64> building;             // 正在某个线程上生成的块（含递归生成的下一层块）
+        QWaitCondition built;               // building 中有块结束时唤醒等待者
+        QAtomicInt cancelled;
+    };
+
+    static quint64 tileKey(int level, int tx, int ty);
+    // 从缓存取一块；别的线程正在生成时等它完成，否则自己生成。在后台线程执行，取消或越界时返回空图
+    static QImage buildTile(State& state, int level, int tx, int ty);
+    // 拼出上一层对应的 2×2 块并降采样，不查缓存
+    static QImage generateTile(State& state, int level, int tx, int ty);
+    void cancelBuilds();
+
+    TiledImage source;
+    DownsampleMethod downsample;
+    QSharedPointer<State> state;
+    QThreadPool builders;
+};
+
+#endif // IMAGEPYRAMID_H
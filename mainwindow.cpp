@@ -3,22 +3,24 @@
 #include "waterlinedialog.h"
 #include "slantrangedialog.h"
 #include <QFileDialog>
+#include <QStatusBar>
 #include <QDebug>
-#include <QGraphicsPixmapItem>
+#include <QThread>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
-
-    xtfparser = new xtfparse(this);
-    scene = new QGraphicsScene(this);
-    ui->graphicsView->setScene(scene);
+    ui->loadProgressBar->setRange(0, 100);
+    setLoading(false);
 }
 
 MainWindow::~MainWindow()
 {
+    stopLoad();
+    // 已取消的读取线程会很快退出；关闭窗口时等它们结束，线程对象才能随窗口销毁
+    for (QThread* thread : findChildren<QThread*>()) thread->wait();
     delete ui;
 }
 
@@ -27,80 +29,196 @@ void MainWindow::on_openFileButton_clicked()
     QString fileName = QFileDialog::getOpenFileName(this, "打开 XTF 文件", "", "XTF Files (*.xtf)");
     if (fileName.isEmpty()) return;
 
+    stopLoad();
+
     portData.clear();
     starboardData.clear();
+    nativeData.clear();
+    pingMeta.clear();
+    previewPort.clear();
+    previewStarboard.clear();
+    dataset.reset();
+    // 预览到达之前瀑布图直接显示正在累积的 ping 矩阵
+    ui->waterfallView->setPingData(&portData, &starboardData);
+
+    // 在工作线程中流式读取，数据分批到达时逐步追加瀑布图
+    startLoad(fileName);
+}
+
+void MainWindow::on_cancelLoadButton_clicked()
+{
+    stopLoad();
+    publishDataset();   // 已读到的部分照常可用
+    setLoading(false);
+}
+
+void MainWindow::startLoad(const QString &fileName)
+{
+    loadingFile = fileName;
+    const int generation = ++loadGeneration;
+
+    loadThread = new QThread(this);
+    loadWorker = new XtfLoadWorker;
+    // 原始位深样本只在需要换映射时才保留，默认不保留，16 位文件不再多占两倍内存
+    loadWorker->setKeepNativeSamples(false);
+    loadWorker->setChannelMask(channelMask);
+    loadWorker->setSampleMapping(sampleMapping);
+    // 跟随写入时直接显示新到的 ping，预览只是打开时的快照，不再需要
+    const bool follow = ui->followCheckBox->isChecked();
+    loadWorker->setFollowGrowth(follow);
+    loadWorker->setPreviewEnabled(!follow);
+    loadWorker->moveToThread(loadThread);
+    connect(loadThread, &QThread::finished, loadWorker, &QObject::deleteLater);
+
+    connect(loadWorker, &XtfLoadWorker::previewReady, this, [this, generation](const PingBatch& preview, int stride) {
+        if (generation == loadGeneration) showPreview(preview, stride);
+    });
+    connect(loadWorker, &XtfLoadWorker::batchReady, this, [this, generation](const PingBatch& batch) {
+        if (generation == loadGeneration) appendPingBatch(batch);
+    });
+    connect(loadWorker, &XtfLoadWorker::progressChanged, this, [this, generation](int percent) {
+        if (generation == loadGeneration) ui->loadProgressBar->setValue(percent);
+    });
+    connect(loadWorker, &XtfLoadWorker::reachedEnd, this, [this, generation]() {
+        if (generation == loadGeneration) onReachedEnd();
+    });
+    connect(loadWorker, &XtfLoadWorker::finished, this, [this, generation](bool completed) {
+        if (generation == loadGeneration) onLoadFinished(completed);
+    });
+
+    loadThread->start();
+    QMetaObject::invokeMethod(loadWorker, "load", Qt::QueuedConnection, Q_ARG(QString, fileName));
+
+    ui->loadProgressBar->setValue(0);
+    setLoading(true);
+}
+
+void MainWindow::stopLoad()
+{
+    if (!loadThread) return;
+
+    ++loadGeneration;   // 之后到达的旧信号全部丢弃
+    loadWorker->cancel();
+    // 不在界面线程等待：解析检查到取消后返回，线程结束时线程和 loadWorker 都通过 deleteLater 释放
+    connect(loadThread, &QThread::finished, loadThread, &QObject::deleteLater);
+    loadThread->quit();
+    loadThread = nullptr;
+    loadWorker = nullptr;
+}
+
+void MainWindow::setLoading(bool loading)
+{
+    ui->loadProgressBar->setVisible(loading);
+    ui->cancelLoadButton->setVisible(loading);
+    ui->followCheckBox->setEnabled(!loading);
+    // 跟随写入时数据一经发布就可以使用工具
+    const bool toolsReady = !loading || (dataset && !dataset->isEmpty());
+    ui->bottomTrackButton->setEnabled(toolsReady);
+    ui->Imagefusion->setEnabled(toolsReady);
+}
 
-    xtfparser->parseXtfHeader(fileName, portData, starboardData);
+void MainWindow::appendPingBatch(const PingBatch &batch)
+{
+    if (batch.port.isEmpty() && batch.starboard.isEmpty()) return;
+
+    portData.append(batch.port);
+    starboardData.append(batch.starboard);
+    nativeData.append(batch.native);
+    pingMeta.append(batch.meta);
 
-    if (portData.isEmpty() && starboardData.isEmpty()) {
+    // 只重画可见的 ping，不再为每批生成图像；显示预览时完整数据在后台累积，读完再切换。
+    // 跟随写入已发布数据集后，瀑布图显示的是数据集，新 ping 等下次追上写入进度时一起发布
+    if (!dataset && previewPort.isEmpty() && previewStarboard.isEmpty()) ui->waterfallView->pingsAppended();
+}
+
+void MainWindow::showPreview(const PingBatch &preview, int stride)
+{
+    if (preview.port.isEmpty() && preview.starboard.isEmpty()) return;
+
+    statusBar()->showMessage(QString("预览：每 %1 个 ping 取一行，完整数据读取中").arg(stride));
+    previewPort = preview.port;
+    previewStarboard = preview.starboard;
+    ui->waterfallView->setPingData(&previewPort, &previewStarboard);
+}
+
+void MainWindow::onLoadFinished(bool completed)
+{
+    stopLoad();
+    setLoading(false);
+
+    // 跟随写入时数据可能已经发布
+    publishDataset();
+    if (!dataset) {
         qWarning() << "没有读取到有效数据";
         return;
     }
-    qDebug()<<"size:"<<portData[0].size();
+    statusBar()->showMessage(QString("读取%1，ping 数：%2").arg(completed ? "完成" : "中断").arg(dataset->pingCount()));
+}
 
-    // 使用 SonogramGenerator 生成图像
-    QImage sonarImg = generator.createSonogram(portData, starboardData, true);
+void MainWindow::onReachedEnd()
+{
+    // 跟随写入每次追上写入进度：把新读到的 ping 发布成新的数据集并开放工具。
+    // 已打开的对话框继续使用各自拿到的数据集，不会在使用中被修改
+    if (!publishDataset()) return;   // 没有新的 ping，下次追上写入进度时再发布
+    setLoading(true);
+}
 
-    if (sonarImg.isNull()) {
-        qWarning() << "生成声呐图失败";
-        return;
+bool MainWindow::publishDataset()
+{
+    if (portData.isEmpty() && starboardData.isEmpty()) return false;
+
+    // 已发布的数据集只读共享，复制一份接上新 ping，而不是在原处追加
+    if (dataset) {
+        PingMatrix port = dataset->port();
+        PingMatrix starboard = dataset->starboard();
+        NativeSamples native = dataset->nativeSamples();
+        PingMetaTable meta = dataset->pingMeta();
+        port.append(portData);
+        starboard.append(starboardData);
+        native.append(nativeData);
+        meta.append(pingMeta);
+        portData = std::move(port);
+        starboardData = std::move(starboard);
+        nativeData = std::move(native);
+        pingMeta = std::move(meta);
     }
 
-    fitToWidth(ui->graphicsView, sonarImg);
+    QSharedPointer<SonarDataset> data(new SonarDataset(std::move(portData), std::move(starboardData),
+                                                       std::move(nativeData), std::move(pingMeta)));
+    data->setSourceFile(loadingFile);
+    data->setDecodeSettings(channelMask, sampleMapping);
+    dataset = data;
+    ui->waterfallView->setDataset(dataset);   // 累积的矩阵已移入数据集
+    previewPort.clear();
+    previewStarboard.clear();
+    portData.clear();
+    starboardData.clear();
+    nativeData.clear();
+    pingMeta.clear();
+    return true;
 }
 
 void MainWindow::on_bottomTrackButton_clicked()
 {
-    // 确保有图像
-    QImage sonarImg = generator.createSonogram(portData, starboardData, true);
-    if (sonarImg.isNull()) {
+    // 确保有数据，底图由 dataset 缓存，不再每次重新生成
+    if (!dataset || dataset->isEmpty()) {
         qWarning() << "没有可用图像";
         return;
     }
 
     WaterlineDialog dlg(this);
-    dlg.setData(portData, starboardData, sonarImg);
+    dlg.setData(dataset);
     dlg.exec();
 }
 
 void MainWindow::on_Imagefusion_clicked()
 {
-    QImage sonarImg = generator.createSonogram(portData, starboardData, true);
-    if (sonarImg.isNull()) {
+    if (!dataset || dataset->isEmpty()) {
         qWarning() << "没有可用图像";
         return;
     }
 
     SlantRangeDialog dlg(this);
-    dlg.setData(portData, starboardData, sonarImg);
+    dlg.setData(dataset);
     dlg.exec();
 }
-
-
-void MainWindow::fitToWidth(QGraphicsView *view, QImage &image)
-{
-    if (image.isNull()) return;
-
-    // 清空并重新设置 scene
-    scene->clear();
-    QGraphicsPixmapItem* item = scene->addPixmap(QPixmap::fromImage(image));
-    view->setScene(scene);
-
-    // 按宽度计算缩放比例
-    qreal viewWidth = view->viewport()->width();
-    qreal imgWidth  = image.width();
-    if (imgWidth > 0) {
-        qreal scaleFactor = viewWidth / imgWidth;
-
-        QTransform transform;
-        transform.scale(scaleFactor, scaleFactor);
-        view->setTransform(transform);
-    }
-
-    // 水平方向关闭滚动条，垂直方向根据需要出现
-    view->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    view->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-
-    // 保证 scene 大小与图像一致
-    scene->setSceneRect(item->boundingRect());
-}
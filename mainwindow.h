@@ -2,9 +2,10 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QGraphicsScene>
-#include "xtfparse.h"
-#include "sonogramgenerator.h"
+#include "xtfloadworker.h"
+#include "sonardataset.h"
+
+class QThread;
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -20,22 +21,39 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
-    void fitToWidth(QGraphicsView* view, QImage& image);    //适配宽度显示
-
-
 private:
-    Ui::MainWindow *ui;
+    // 后台流式读取
+    void startLoad(const QString& fileName);
+    void stopLoad();
+    void setLoading(bool loading);
+    void appendPingBatch(const PingBatch& batch);
+    void showPreview(const PingBatch& preview, int stride);
+    void onLoadFinished(bool completed);
+    void onReachedEnd();
+    // 把累积的数据（跟随写入时接在已发布的数据之后）移入新的数据集并显示，没有新数据时返回 false
+    bool publishDataset();
 
-    xtfparse *xtfparser;   // 解析器对象
-    QVector<std::vector<uint8_t>> portData;
-    QVector<std::vector<uint8_t>> starboardData;
+    Ui::MainWindow *ui;
 
-    SonogramGenerator generator;  // 声图生成器
-    QGraphicsScene *scene;        // GraphicsScene，用来显示图像
+    PingMatrix portData;          // 读取过程中逐批累积
+    PingMatrix starboardData;
+    NativeSamples nativeData;     // 16/32 位文件的原始样本，换映射时不必重新解析
+    PingMetaTable pingMeta;   // 每个 ping 的参数
+    PingMatrix previewPort;       // 整条测线的低分辨率预览，完整数据读完之前显示
+    PingMatrix previewStarboard;
+    QString loadingFile;          // 正在读取的文件
+    quint64 channelMask = 0x3;    // 只显示第一对左右舷，双频文件的另一对直接跳过
+    SampleMapping sampleMapping;  // 16/32 位样本到 8 位的映射
+    SonarDatasetPtr dataset;      // 读取结束（跟随写入时每次读到文件尾）后交给各对话框共享的只读数据
+
+    QThread *loadThread = nullptr;
+    XtfLoadWorker *loadWorker = nullptr;
+    int loadGeneration = 0;       // 每次读取递增，丢弃上一次读取残留的信号
 
 private slots:
     void on_openFileButton_clicked();
     void on_bottomTrackButton_clicked();
     void on_Imagefusion_clicked();
+    void on_cancelLoadButton_clicked();
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,122 @@
+#include "pingdecoder.h"
+#include "sampleconverter.h"
+#include "xtfmappedreader.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+// 各样本类型整行转换为 8 位 / 拷贝为本机字节序
+template <typename Sample> struct SampleTraits;
+
+template <> struct SampleTraits<uint8_t> {
+    static void toDisplay(const SampleConverter&, const uint8_t* src, uint8_t* dst, int count)
+    {
+        std::memcpy(dst, src, count);
+    }
+};
+
+template <> struct SampleTraits<uint16_t> {
+    static void toDisplay(const SampleConverter& converter, const uint8_t* src, uint8_t* dst, int count)
+    {
+        converter.convert16(src, dst, count);
+    }
+};
+
+template <> struct SampleTraits<uint32_t> {
+    static void toDisplay(const SampleConverter& converter, const uint8_t* src, uint8_t* dst, int count)
+    {
+        converter.convert32(src, dst, count);
+    }
+};
+
+template <typename Sample>
+inline void copyNative(const uint8_t* src, uint8_t* dst, int count)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    std::memcpy(dst, src, sizeof(Sample) * count);
+#else
+    Sample* out = reinterpret_cast<Sample*>(dst);
+    for (int k = 0; k < count; ++k) out[k] = qFromLittleEndian<Sample>(src + sizeof(Sample) * k);
+#endif
+}
+
+// 所有通道位宽相同。Channels 为 0 表示通道数在运行时确定，否则循环在编译期展开
+template <typename Sample, int Channels>
+void decodeUniform(const PingView& ping, const SampleConverter& converter, const PingRowTargets& rows)
+{
+    const int count = Channels > 0 ? Channels : qMin(ping.channelCount, rows.display.size());
+    for (int i = 0; i < count; ++i) {
+        const PingChannelView& channel = ping.channels[i];
+        if (rows.display[i]) SampleTraits<Sample>::toDisplay(converter, channel.samples, rows.display[i], channel.numSamples);
+        if (rows.native[i]) copyNative<Sample>(channel.samples, rows.native[i], channel.numSamples);
+    }
+}
+
+// 混合位宽（或 ping 的通道数少于文件声明）时按通道分派，保留样本按无符号数扩展到 nativeBytes
+void decodeMixed(const PingView& ping, const SampleConverter& converter, const PingRowTargets& rows)
+{
+    const int count = qMin(ping.channelCount, rows.display.size());
+    for (int i = 0; i < count; ++i) {
+        const PingChannelView& channel = ping.channels[i];
+        if (rows.display[i]) converter.convert(channel.samples, channel.bytesPerSample, rows.display[i], channel.numSamples);
+        if (rows.native[i]) {
+            PingDecoder::copyNativeSamples(channel.samples, channel.bytesPerSample, rows.native[i],
+                                           rows.nativeBytes, channel.numSamples);
+        }
+    }
+}
+
+template <typename Sample>
+PingDecoder::DecodeFn selectForSample(int channelCount)
+{
+    switch (channelCount) {
+    case 1: return &decodeUniform<Sample, 1>;
+    case 2: return &decodeUniform<Sample, 2>;   // 单频左右舷
+    case 4: return &decodeUniform<Sample, 4>;   // 双频：低频左右舷 + 高频左右舷
+    default: return &decodeUniform<Sample, 0>;
+    }
+}
+
+} // namespace
+
+PingDecoder::PingDecoder(const QVector<int>& bytesPerSample)
+    : channels(bytesPerSample.size())
+{
+    uniformBytes = channels > 0 ? bytesPerSample[0] : 1;
+    for (int bytes : bytesPerSample) {
+        if (bytes != uniformBytes) uniformBytes = 0;
+    }
+
+    switch (uniformBytes) {
+    case 1: decodeFn = selectForSample<uint8_t>(channels); break;
+    case 2: decodeFn = selectForSample<uint16_t>(channels); break;
+    case 4: decodeFn = selectForSample<uint32_t>(channels); break;
+    default: decodeFn = &decodeMixed; break;
+    }
+}
+
+void PingDecoder::decode(const PingView& ping, const SampleConverter& converter, const PingRowTargets& rows) const
+{
+    // 特化版本假定 ping 至少有 channels 个通道，且保留样本与文件位宽一致
+    const bool nativeMatches = rows.nativeBytes == 0 || rows.nativeBytes == uniformBytes;
+    if (ping.channelCount >= channels && nativeMatches) decodeFn(ping, converter, rows);
+    else decodeMixed(ping, converter, rows);
+}
+
+void PingDecoder::copyNativeSamples(const uint8_t* src, int srcBytes, uint8_t* dst, int dstBytes, int count)
+{
+    if (srcBytes == dstBytes && Q_BYTE_ORDER == Q_LITTLE_ENDIAN) {
+        std::memcpy(dst, src, static_cast<size_t>(count) * dstBytes);
+        return;
+    }
+    for (int k = 0; k < count; ++k) {
+        uint32_t value = 0;
+        if (srcBytes == 1) value = src[k];
+        else if (srcBytes == 2) value = qFromLittleEndian<quint16>(src + 2 * k);
+        else if (srcBytes == 4) value = qFromLittleEndian<quint32>(src + 4 * k);
+
+        if (dstBytes == 2) reinterpret_cast<uint16_t*>(dst)[k] = static_cast<uint16_t>(value);
+        else reinterpret_cast<uint32_t*>(dst)[k] = value;
+    }
+}
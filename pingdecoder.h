@@ -0,0 +1,50 @@
+#ifndef PINGDECODER_H
+#define PINGDECODER_H
+
+#include <QVector>
+#include <QVarLengthArray>
+#include <cstdint>
+
+struct PingView;
+class SampleConverter;
+
+// 一个 ping 各通道样本的写入位置，为 nullptr 时跳过该通道
+struct PingRowTargets {
+    QVarLengthArray<uint8_t*, 8> display;   // 8 位显示样本
+    QVarLengthArray<uint8_t*, 8> native;    // 原始位深样本，每个 nativeBytes 字节
+    int nativeBytes = 0;
+
+    void reset(int channelCount)
+    {
+        display.resize(channelCount);
+        native.resize(channelCount);
+        for (int i = 0; i < channelCount; ++i) display[i] = native[i] = nullptr;
+    }
+};
+
+// 按文件的通道布局选出的 ping 解码器：样本位宽和通道数作为模板参数特化，
+// 每个文件只选一次，解码循环里不再按通道或按样本判断位宽
+class PingDecoder
+{
+public:
+    // bytesPerSample[i] 为第 i 个要解码的通道的样本位宽（来自 CHANINFO）
+    explicit PingDecoder(const QVector<int>& bytesPerSample);
+
+    int channelCount() const { return channels; }
+    // 各通道位宽一致时返回该位宽，混合位宽返回 0
+    int uniformBytesPerSample() const { return uniformBytes; }
+
+    void decode(const PingView& ping, const SampleConverter& converter, const PingRowTargets& rows) const;
+
+    // 文件中的小端样本拷贝为本机字节序，位宽不同时按无符号数扩展
+    static void copyNativeSamples(const uint8_t* src, int srcBytes, uint8_t* dst, int dstBytes, int count);
+
+    typedef void (*DecodeFn)(const PingView& ping, const SampleConverter& converter, const PingRowTargets& rows);
+
+private:
+    DecodeFn decodeFn = nullptr;
+    int channels = 0;
+    int uniformBytes = 0;
+};
+
+#endif // PINGDECODER_H
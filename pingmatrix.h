@@ -0,0 +1,135 @@
+#ifndef PINGMATRIX_H
+#define PINGMATRIX_H
+
+#include <QtGlobal>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// 按行连续存放的 ping 矩阵：一舷的所有样本放在同一块内存里，
+// 每行（一个 ping）记录起始偏移，允许各 ping 样本数不同
+template <typename T>
+class BasicPingMatrix
+{
+public:
+    BasicPingMatrix()
+        : offsets(1, 0)
+    {
+    }
+
+    void clear()
+    {
+        samples.clear();
+        offsets.assign(1, 0);
+        widest = 0;
+        uniform = true;
+    }
+
+    // 预先分配，已知 ping 数和样本总数时只分配一次
+    void reserve(int pings, qint64 totalSamples)
+    {
+        offsets.reserve(static_cast<size_t>(pings) + 1);
+        samples.reserve(static_cast<size_t>(totalSamples));
+    }
+
+    // 追加一行，返回行首指针，由调用者填充
+    T* appendRow(int numSamples)
+    {
+        const qint64 begin = offsets.back();
+        samples.resize(static_cast<size_t>(begin + numSamples));
+        offsets.push_back(begin + numSamples);
+        noteRowSize(numSamples);
+        return samples.data() + begin;
+    }
+
+    // 复制一行，直接追加字节，不先清零
+    void appendRow(const T* src, int numSamples)
+    {
+        if (numSamples < 0) numSamples = 0;
+        samples.insert(samples.end(), src, src + numSamples);
+        offsets.push_back(offsets.back() + numSamples);
+        noteRowSize(numSamples);
+    }
+
+    // 逐批追加时容量按倍数增长，避免每批都重新分配并复制整块内存
+    void append(const BasicPingMatrix& other)
+    {
+        if (other.isEmpty()) return;
+        grow(offsets, offsets.size() + other.rows());
+        grow(samples, samples.size() + static_cast<size_t>(other.totalSamples()));
+
+        const qint64 base = offsets.back();
+        samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+        for (int i = 0; i < other.rows(); ++i) {
+            offsets.push_back(base + other.offsets[i + 1]);
+            noteRowSize(other.rowSize(i));
+        }
+    }
+
+    int rows() const { return static_cast<int>(offsets.size()) - 1; }
+    bool isEmpty() const { return rows() == 0; }
+
+    int rowSize(int ping) const { return static_cast<int>(offsets[ping + 1] - offsets[ping]); }
+    qint64 rowOffset(int ping) const { return offsets[ping]; }
+    const T* row(int ping) const { return samples.data() + offsets[ping]; }
+    T* row(int ping) { return samples.data() + offsets[ping]; }
+
+    // 最长一行的样本数（图像宽度）
+    int maxRowSize() const { return widest; }
+    // 所有行等长时可以按固定步长访问
+    bool isUniform() const { return uniform; }
+
+    qint64 totalSamples() const { return offsets.back(); }
+    const T* data() const { return samples.data(); }
+
+private:
+    void noteRowSize(int numSamples)
+    {
+        if (rows() == 1) widest = numSamples;
+        else if (numSamples != widest) uniform = false;
+        if (numSamples > widest) widest = numSamples;
+    }
+
+    template <typename V>
+    static void grow(V& v, size_t needed)
+    {
+        if (needed > v.capacity()) v.reserve(std::max(needed, 2 * v.capacity()));
+    }
+
+    std::vector<T> samples;         // 所有 ping 的样本，按行连续存放
+    std::vector<qint64> offsets;    // 每行起始偏移，多存一个结尾
+    int widest = 0;
+    bool uniform = true;
+};
+
+typedef BasicPingMatrix<uint8_t> PingMatrix;
+typedef BasicPingMatrix<uint16_t> PingMatrix16;
+typedef BasicPingMatrix<uint32_t> PingMatrix32;
+
+// 保留原始位深的左右舷样本，用于换一种映射重新生成 8 位显示数据。
+// bytesPerSample 为 2 时用 port16/starboard16，为 4 时用 port32/starboard32，为 0 表示没有保留
+struct NativeSamples {
+    int bytesPerSample = 0;
+    PingMatrix16 port16, starboard16;
+    PingMatrix32 port32, starboard32;
+
+    bool isEmpty() const { return bytesPerSample == 0; }
+
+    void clear()
+    {
+        bytesPerSample = 0;
+        port16.clear(); starboard16.clear();
+        port32.clear(); starboard32.clear();
+    }
+
+    void append(const NativeSamples& other)
+    {
+        if (other.isEmpty()) return;
+        if (bytesPerSample == 0) bytesPerSample = other.bytesPerSample;
+        port16.append(other.port16); starboard16.append(other.starboard16);
+        port32.append(other.port32); starboard32.append(other.starboard32);
+    }
+};
+
+#endif // PINGMATRIX_H
@@ -0,0 +1,123 @@
+#ifndef PINGMETA_H
+#define PINGMETA_H
+
+#include <QtGlobal>
+#include <vector>
+
+// 单个 ping 通道的参数
+struct PingMeta {
+    int numSamples = 0;         // 样点数
+    double timeDuration = 0.0;  // 总采样时长 (s)
+    double sampleInterval = 0.0;    // 每个样点的采样间隔 (s)
+    double soundVelocity = 0.0; // 声速 (m/s)，可能已经除过2
+    double slantRange = 0.0;    // 最大斜距 (m)
+    double altitude = 0.0;      // 离底高度 (m)，主高度计无效时取辅助高度，都无效时为 0
+    double time = 0.0;          // ping 时间，UTC 秒（自 1970 年起，含百分秒），日期无效时为 0
+    double x = 0.0;             // 经度/东坐标，传感器坐标无效时取船坐标
+    double y = 0.0;             // 纬度/北坐标
+    double heading = 0.0;       // 航向 (°)
+    double speed = 0.0;         // 速度 (knots)，传感器速度无效时取船速
+
+    // 一个样点对应的斜距 (m)，参数无效时为 0
+    double metersPerSample() const { return soundVelocity * sampleInterval; }
+};
+
+// 按列存放的 ping 参数表，第 i 行对应第 i 个 ping（与左右舷 PingMatrix 的行号一致）。
+// 各列连续存放，斜距矫正、沿航迹缩放、地理配准按列读取，不必重新解析文件
+class PingMetaTable
+{
+public:
+    void clear()
+    {
+        for (std::vector<double>* column : doubleColumns()) column->clear();
+        samples.clear();
+    }
+
+    void reserve(int pings)
+    {
+        for (std::vector<double>* column : doubleColumns()) column->reserve(static_cast<size_t>(pings));
+        samples.reserve(static_cast<size_t>(pings));
+    }
+
+    void append(const PingMeta& meta)
+    {
+        samples.push_back(meta.numSamples);
+        times.push_back(meta.time);
+        xs.push_back(meta.x);
+        ys.push_back(meta.y);
+        headings.push_back(meta.heading);
+        speeds.push_back(meta.speed);
+        altitudes.push_back(meta.altitude);
+        velocities.push_back(meta.soundVelocity);
+        intervals.push_back(meta.sampleInterval);
+        ranges.push_back(meta.slantRange);
+    }
+
+    void append(const PingMetaTable& other)
+    {
+        const std::vector<std::vector<double>*> mine = doubleColumns();
+        const std::vector<const std::vector<double>*> theirs = other.doubleColumns();
+        for (size_t c = 0; c < mine.size(); ++c) {
+            mine[c]->insert(mine[c]->end(), theirs[c]->begin(), theirs[c]->end());
+        }
+        samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+    }
+
+    int size() const { return static_cast<int>(samples.size()); }
+    bool isEmpty() const { return samples.empty(); }
+
+    // 第 ping 行拼回一个 PingMeta（timeDuration 由样点数和采样间隔换算）
+    PingMeta at(int ping) const
+    {
+        PingMeta meta;
+        meta.numSamples = samples[ping];
+        meta.sampleInterval = intervals[ping];
+        meta.timeDuration = intervals[ping] * samples[ping];
+        meta.soundVelocity = velocities[ping];
+        meta.slantRange = ranges[ping];
+        meta.altitude = altitudes[ping];
+        meta.time = times[ping];
+        meta.x = xs[ping];
+        meta.y = ys[ping];
+        meta.heading = headings[ping];
+        meta.speed = speeds[ping];
+        return meta;
+    }
+
+    double metersPerSample(int ping) const { return velocities[ping] * intervals[ping]; }
+
+    // 各列
+    const std::vector<int>& numSamples() const { return samples; }
+    const std::vector<double>& time() const { return times; }
+    const std::vector<double>& x() const { return xs; }
+    const std::vector<double>& y() const { return ys; }
+    const std::vector<double>& heading() const { return headings; }
+    const std::vector<double>& speed() const { return speeds; }
+    const std::vector<double>& altitude() const { return altitudes; }
+    const std::vector<double>& soundVelocity() const { return velocities; }
+    const std::vector<double>& sampleInterval() const { return intervals; }
+    const std::vector<double>& slantRange() const { return ranges; }
+
+private:
+    std::vector<std::vector<double>*> doubleColumns()
+    {
+        return {&times, &xs, &ys, &headings, &speeds, &altitudes, &velocities, &intervals, &ranges};
+    }
+    std::vector<const std::vector<double>*> doubleColumns() const
+    {
+        return {&times, &xs, &ys, &headings, &speeds, &altitudes, &velocities, &intervals, &ranges};
+    }
+
+    std::vector<int> samples;
+    std::vector<double> times;
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::vector<double> headings;
+    std::vector<double> speeds;
+    std::vector<double> altitudes;
+    std::vector<double> velocities;
+    std::vector<double> intervals;
+    std::vector<double> ranges;
+};
+
+#endif // PINGMETA_H
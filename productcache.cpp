@@ -0,0 +1,262 @@
+#include "productcache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+const char kProductMagic[8] = {'X', 'T', 'F', 'P', 'R', 'O', 'D', '\0'};
+const uint32_t kProductVersion = 1;
+
+const qint64 kEdgeBytes = 1024 * 1024;      // 指纹：文件头尾各读的字节数
+const int kSampleBlocks = 64;               // 指纹：中间均匀抽取的块数
+const qint64 kSampleBlockBytes = 64 * 1024;
+
+std::atomic<qint64> maxBytes{2LL * 1024 * 1024 * 1024};   // 缓存目录总大小上限
+
+enum ProductKind : uint32_t {
+    LinesProduct = 1,
+    ImageProduct = 2
+};
+
+#pragma pack(push, 1)
+struct ProductFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t kind;
+    char     paramsHash[20];    // 参数的 SHA-1，防止文件名冲突时误读
+};
+#pragma pack(pop)
+
+void fillHeader(ProductFileHeader& header, ProductKind kind, const QByteArray& params)
+{
+    std::memcpy(header.magic, kProductMagic, sizeof(kProductMagic));
+    header.version = kProductVersion;
+    header.kind = kind;
+    const QByteArray hash = QCryptographicHash::hash(params, QCryptographicHash::Sha1);
+    std::memcpy(header.paramsHash, hash.constData(), sizeof(header.paramsHash));
+}
+
+bool checkHeader(QFile& file, ProductKind kind, const QByteArray& params)
+{
+    ProductFileHeader header{};
+    ProductFileHeader expected{};
+    fillHeader(expected, kind, params);
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)) return false;
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+        qDebug() << "产品缓存格式或参数不匹配：" << file.fileName();
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+bool readValue(QFile& file, T& value)
+{
+    return file.read(reinterpret_cast<char*>(&value), sizeof(T)) == sizeof(T);
+}
+
+template <typename T>
+void writeValue(QSaveFile& file, const T& value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+}
+
+ProductCache::ProductCache()
+{
+}
+
+ProductCache::ProductCache(const QByteArray &dataKey)
+    : key(dataKey.isEmpty() ? QByteArray()
+                            : QCryptographicHash::hash(dataKey, QCryptographicHash::Sha1).toHex())
+{
+}
+
+QByteArray ProductCache::fingerprint(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+
+    const qint64 size = file.size();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(reinterpret_cast<const char*>(&size), sizeof(size));
+    const qint64 modified = QFileInfo(filePath).lastModified().toMSecsSinceEpoch();
+    hash.addData(reinterpret_cast<const char*>(&modified), sizeof(modified));
+
+    auto addRange = [&](qint64 offset, qint64 bytes) {
+        if (offset < 0 || bytes <= 0 || !file.seek(offset)) return;
+        hash.addData(file.read(qMin(bytes, size - offset)));
+    };
+
+    addRange(0, kEdgeBytes);
+    if (size > 2 * kEdgeBytes) {
+        const qint64 middle = size - 2 * kEdgeBytes;
+        for (int i = 0; i < kSampleBlocks; ++i) {
+            addRange(kEdgeBytes + middle * i / kSampleBlocks, kSampleBlockBytes);
+        }
+        addRange(size - kEdgeBytes, kEdgeBytes);
+    }
+    return hash.result().toHex();
+}
+
+QString ProductCache::cacheRoot()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/products";
+}
+
+void ProductCache::setMaxCacheBytes(qint64 bytes)
+{
+    maxBytes = qMax<qint64>(0, bytes);
+}
+
+qint64 ProductCache::maxCacheBytes()
+{
+    return maxBytes;
+}
+
+void ProductCache::evict(const QString &keepPath)
+{
+    QVector<QFileInfo> files;
+    qint64 total = 0;
+    QDirIterator it(cacheRoot(), QStringList() << "*.bin", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        files.append(it.fileInfo());
+        total += it.fileInfo().size();
+    }
+    if (total <= maxBytes) return;
+
+    std::sort(files.begin(), files.end(), [](const QFileInfo& a, const QFileInfo& b) {
+        return a.lastModified() < b.lastModified();
+    });
+    const QString keep = QFileInfo(keepPath).absoluteFilePath();
+    for (const QFileInfo& info : files) {
+        if (total <= maxBytes) break;
+        if (info.absoluteFilePath() == keep) continue;
+        if (QFile::remove(info.absoluteFilePath())) {
+            total -= info.size();
+            QDir().rmdir(info.absolutePath());   // 某个源文件的产品删空后连目录一起删除
+        }
+    }
+}
+
+QString ProductCache::pathFor(const QString &product, const QByteArray &params) const
+{
+    const QByteArray paramsKey = QCryptographicHash::hash(params, QCryptographicHash::Md5).toHex();
+    return cacheRoot() + "/" + QString::fromLatin1(key) + "/" + product + "-" + QString::fromLatin1(paramsKey) + ".bin";
+}
+
+bool ProductCache::loadLines(const QString &product, const QByteArray &params, QVector<QVector<int>> &lines) const
+{
+    if (!isValid()) return false;
+
+    QFile file(pathFor(product, params));
+    if (!file.open(QIODevice::ReadOnly) || !checkHeader(file, LinesProduct, params)) return false;
+
+    quint32 count = 0;
+    if (!readValue(file, count)) return false;
+    QVector<QVector<int>> result(static_cast<int>(count));
+    for (QVector<int>& line : result) {
+        quint32 size = 0;
+        if (!readValue(file, size)) return false;
+        const qint64 bytes = static_cast<qint64>(size) * sizeof(qint32);
+        if (bytes > file.size() - file.pos()) return false;
+        line.resize(static_cast<int>(size));
+        if (file.read(reinterpret_cast<char*>(line.data()), bytes) != bytes) return false;
+    }
+    lines = result;
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);   // 记录最近使用
+    return true;
+}
+
+bool ProductCache::saveLines(const QString &product, const QByteArray &params, const QVector<QVector<int>> &lines) const
+{
+    if (!isValid()) return false;
+
+    const QString path = pathFor(product, params);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "无法写入产品缓存：" << path;
+        return false;
+    }
+
+    ProductFileHeader header{};
+    fillHeader(header, LinesProduct, params);
+    writeValue(file, header);
+    writeValue(file, static_cast<quint32>(lines.size()));
+    for (const QVector<int>& line : lines) {
+        writeValue(file, static_cast<quint32>(line.size()));
+        file.write(reinterpret_cast<const char*>(line.constData()), static_cast<qint64>(line.size()) * sizeof(qint32));
+    }
+    if (!file.commit()) return false;
+    evict(path);
+    return true;
+}
+
+bool ProductCache::loadImage(const QString &product, const QByteArray &params, TiledImage &image) const
+{
+    if (!isValid()) return false;
+
+    QFile file(pathFor(product, params));
+    if (!file.open(QIODevice::ReadOnly) || !checkHeader(file, ImageProduct, params)) return false;
+
+    quint32 tileCount = 0;
+    if (!readValue(file, tileCount)) return false;
+    TiledImage result;
+    for (quint32 i = 0; i < tileCount; ++i) {
+        qint32 width = 0, height = 0;
+        if (!readValue(file, width) || !readValue(file, height) || width <= 0 || height <= 0) return false;
+        if (static_cast<qint64>(width) * height > file.size() - file.pos()) return false;
+
+        // 逐行读入，文件中不含行尾对齐的填充
+        QImage tile(width, height, QImage::Format_Grayscale8);
+        for (int y = 0; y < height; ++y) {
+            if (file.read(reinterpret_cast<char*>(tile.scanLine(y)), width) != width) return false;
+        }
+        result.append(tile);
+    }
+    image = result;
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);   // 记录最近使用
+    return true;
+}
+
+bool ProductCache::saveImage(const QString &product, const QByteArray &params, const TiledImage &image) const
+{
+    if (!isValid() || image.isEmpty()) return false;
+
+    const QString path = pathFor(product, params);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "无法写入产品缓存：" << path;
+        return false;
+    }
+
+    ProductFileHeader header{};
+    fillHeader(header, ImageProduct, params);
+    writeValue(file, header);
+    writeValue(file, static_cast<quint32>(image.tileCount()));
+    for (int i = 0; i < image.tileCount(); ++i) {
+        const QImage tile = image.tile(i).convertToFormat(QImage::Format_Grayscale8);
+        writeValue(file, static_cast<qint32>(tile.width()));
+        writeValue(file, static_cast<qint32>(tile.height()));
+        for (int y = 0; y < tile.height(); ++y) {
+            file.write(reinterpret_cast<const char*>(tile.constScanLine(y)), tile.width());
+        }
+    }
+    if (!file.commit()) return false;
+    evict(path);
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef PRODUCTCACHE_H
+#define PRODUCTCACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "tiledimage.h"
+
+// 派生产品（水线、斜距矫正图等）的磁盘缓存。
+// 按源文件内容指纹分目录，每个产品再按名字和算法参数区分，参数不变时重新打开测线直接读取。
+// 整个缓存目录有总大小上限，写入后按最近使用时间（读取命中时更新文件修改时间）淘汰最旧的产品
+class ProductCache
+{
+public:
+    ProductCache();
+    // dataKey 标识数据内容（源文件指纹加上解析出的 ping 数等），为空时缓存不可用
+    explicit ProductCache(const QByteArray& dataKey);
+
+    bool isValid() const { return !key.isEmpty(); }
+
+    // 文件内容指纹：文件大小、修改时间、文件头尾各 1MB 以及均匀分布的 64 个 64KB 块的 SHA-1。
+    // 多 GB 的测线每次打开都哈希整个文件太慢，所以只抽样；抽样之外原地改写且大小不变的情况
+    // 靠修改时间区分（复制文件改变修改时间时只是缓存不命中）。打不开时返回空
+    static QByteArray fingerprint(const QString& filePath);
+
+    // 若干条等长或不等长的整数线
+    bool loadLines(const QString& product, const QByteArray& params, QVector<QVector<int>>& lines) const;
+    bool saveLines(const QString& product, const QByteArray& params, const QVector<QVector<int>>& lines) const;
+
+    // 灰度图（Grayscale8）
+    bool loadImage(const QString& product, const QByteArray& params, TiledImage& image) const;
+    bool saveImage(const QString& product, const QByteArray& params, const TiledImage& image) const;
+
+    // 缓存根目录
+    static QString cacheRoot();
+
+    // 缓存目录总大小上限（字节），默认 2GB
+    static void setMaxCacheBytes(qint64 bytes);
+    static qint64 maxCacheBytes();
+
+private:
+    QString pathFor(const QString& product, const QByteArray& params) const;
+    // 超过上限时从最久未使用的产品开始删除，keepPath 为刚写入的文件，不删除
+    static void evict(const QString& keepPath);
+
+    QByteArray key;     // 十六进制
+};
+
+#endif // PRODUCTCACHE_H
@@ -0,0 +1,256 @@
+#include "sampleconverter.h"
+#include <QtEndian>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const double FullScale16 = 32768.0;
+const double FullScale32 = 2147483648.0;
+
+// 把 mapping 换算成某一位深下的窗口 [low, low + range]
+void mappingWindow(const SampleMapping& mapping, double fullScale, double maxValue, double& low, double& range)
+{
+    if (mapping.mode == SampleMapping::Linear) {
+        low = 0.0;
+        range = fullScale;
+    } else {
+        low = qBound(0.0, mapping.low, maxValue);
+        range = qMax(1.0, qMin(mapping.high, maxValue) - low);
+    }
+}
+
+inline uint8_t mapLog(double value, double low, double range)
+{
+    if (value <= low) return 0;
+    const double t = std::log1p(value - low) / std::log1p(range);
+    return static_cast<uint8_t>(qBound(0.0, t * 255.0 + 0.5, 255.0));
+}
+
+#if defined(__SSE2__)
+// y = (min(x -sat low, range) * scale) >> 16，结果不超过 255
+inline __m128i map16(__m128i x, __m128i low, __m128i range, __m128i scale)
+{
+    x = _mm_subs_epu16(x, low);
+    x = _mm_sub_epi16(x, _mm_subs_epu16(x, range));     // SSE2 没有 min_epu16
+    return _mm_mulhi_epu16(x, scale);
+}
+
+// 32 位：min(x -sat low, range) >> shift，结果在 [0, 65535]。
+// SSE2 没有无符号 32 位比较，翻转符号位后按有符号比较
+inline __m128i reduce32(__m128i x, __m128i low, __m128i range, __m128i shift)
+{
+    const __m128i sign = _mm_set1_epi32(INT_MIN);
+    const __m128i above = _mm_cmpgt_epi32(_mm_xor_si128(x, sign), _mm_xor_si128(low, sign));
+    x = _mm_and_si128(_mm_sub_epi32(x, low), above);
+    const __m128i over = _mm_cmpgt_epi32(_mm_xor_si128(x, sign), _mm_xor_si128(range, sign));
+    x = _mm_or_si128(_mm_andnot_si128(over, x), _mm_and_si128(over, range));
+    return _mm_srl_epi32(x, shift);
+}
+
+// [0, 65535] 的 32 位值收窄到 16 位：SSE2 只有有符号饱和的 packs，先减 32768 再把符号位翻回来
+inline __m128i packU16(__m128i a, __m128i b)
+{
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32)), bias16);
+}
+#endif
+
+#if defined(__AVX2__)
+inline __m256i map16(__m256i x, __m256i low, __m256i range, __m256i scale)
+{
+    x = _mm256_subs_epu16(x, low);
+    x = _mm256_min_epu16(x, range);
+    return _mm256_mulhi_epu16(x, scale);
+}
+
+inline __m256i reduce32(__m256i x, __m256i low, __m256i range, __m128i shift)
+{
+    x = _mm256_sub_epi32(_mm256_max_epu32(x, low), low);
+    x = _mm256_min_epu32(x, range);
+    return _mm256_srl_epi32(x, shift);
+}
+#endif
+
+} // namespace
+
+SampleConverter::SampleConverter(const SampleMapping& mapping)
+    : map(mapping)
+{
+    double low = 0.0, range = 1.0;
+    mappingWindow(map, FullScale16, 65535.0, low, range);
+    low16 = static_cast<uint32_t>(low);
+    range16 = static_cast<uint32_t>(qMin(range, 65535.0));
+
+    // 窗口不足 256 时定点系数超出 16 位，和对数映射一样改为查表
+    if (map.mode == SampleMapping::Log || range16 < 256) {
+        lut16.resize(65536);
+        for (uint32_t x = 0; x < 65536; ++x) {
+            if (map.mode == SampleMapping::Log) {
+                lut16[x] = mapLog(x, low, range);
+            } else {
+                const uint32_t v = qMin(x > low16 ? x - low16 : 0u, range16);
+                lut16[x] = static_cast<uint8_t>(v * 255 / range16);
+            }
+        }
+    } else {
+        // 系数向上取整，窗口上端正好映射到 255（与查表一致）；range16 >= 256 时不超过 16 位，
+        // v * scale16 < (255 << 16) + range16，结果不会超过 255
+        scale16 = (255u * 65536u + range16 - 1) / range16;
+    }
+
+    // 32 位窗口右移到 16 位以内后沿用 16 位的定点系数；每行转换时不再重新换算
+    mappingWindow(map, FullScale32, 4294967295.0, low, range);
+    low32 = static_cast<uint32_t>(low);
+    range32 = static_cast<uint32_t>(qMin(range, 4294967295.0));
+    while ((range32 >> shift32) > 65535u) ++shift32;
+    const uint32_t reduced = range32 >> shift32;
+    if (reduced >= 256) scale32 = (255u * 65536u + reduced - 1) / reduced;
+}
+
+void SampleConverter::convert16(const uint8_t* src, uint8_t* dst, int count) const
+{
+    if (!lut16.isEmpty()) {
+        const uint8_t* lut = lut16.constData();
+        for (int k = 0; k < count; ++k) {
+            dst[k] = lut[qFromLittleEndian<quint16>(src + 2 * k)];
+        }
+        return;
+    }
+
+    int k = 0;
+#if defined(__AVX2__)
+    {
+        const __m256i low = _mm256_set1_epi16(static_cast<short>(low16));
+        const __m256i range = _mm256_set1_epi16(static_cast<short>(range16));
+        const __m256i scale = _mm256_set1_epi16(static_cast<short>(scale16));
+        for (; k + 32 <= count; k += 32) {
+            const __m256i a = map16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * k)), low, range, scale);
+            const __m256i b = map16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * k + 32)), low, range, scale);
+            // packus 在 128 位通道内交错，需要重排回顺序
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), packed);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128i low = _mm_set1_epi16(static_cast<short>(low16));
+        const __m128i range = _mm_set1_epi16(static_cast<short>(range16));
+        const __m128i scale = _mm_set1_epi16(static_cast<short>(scale16));
+        for (; k + 16 <= count; k += 16) {
+            const __m128i a = map16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * k)), low, range, scale);
+            const __m128i b = map16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * k + 16)), low, range, scale);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + k), _mm_packus_epi16(a, b));
+        }
+    }
+#endif
+    for (; k < count; ++k) {
+        const uint32_t x = qFromLittleEndian<quint16>(src + 2 * k);
+        const uint32_t v = qMin(x > low16 ? x - low16 : 0u, range16);
+        dst[k] = static_cast<uint8_t>(qMin((v * scale16) >> 16, 255u));
+    }
+}
+
+void SampleConverter::convert32(const uint8_t* src, uint8_t* dst, int count) const
+{
+    if (map.mode == SampleMapping::Log) {
+        for (int k = 0; k < count; ++k) {
+            dst[k] = mapLog(qFromLittleEndian<quint32>(src + 4 * k), low32, range32);
+        }
+        return;
+    }
+    if (scale32 == 0) {
+        for (int k = 0; k < count; ++k) {
+            const uint32_t x = qFromLittleEndian<quint32>(src + 4 * k);
+            const uint32_t v = qMin(x > low32 ? x - low32 : 0u, range32);     // range32 < 256，乘积不溢出
+            dst[k] = static_cast<uint8_t>(v * 255u / range32);
+        }
+        return;
+    }
+
+    int k = 0;
+#if defined(__AVX2__)
+    {
+        const __m256i low = _mm256_set1_epi32(static_cast<int>(low32));
+        const __m256i range = _mm256_set1_epi32(static_cast<int>(range32));
+        const __m128i shift = _mm_cvtsi32_si128(shift32);
+        const __m256i scale = _mm256_set1_epi16(static_cast<short>(scale32));
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        for (; k + 32 <= count; k += 32) {
+            const __m256i* in = reinterpret_cast<const __m256i*>(src + 4 * k);
+            const __m256i v0 = reduce32(_mm256_loadu_si256(in), low, range, shift);
+            const __m256i v1 = reduce32(_mm256_loadu_si256(in + 1), low, range, shift);
+            const __m256i v2 = reduce32(_mm256_loadu_si256(in + 2), low, range, shift);
+            const __m256i v3 = reduce32(_mm256_loadu_si256(in + 3), low, range, shift);
+            const __m256i a = _mm256_mulhi_epu16(_mm256_packus_epi32(v0, v1), scale);
+            const __m256i b = _mm256_mulhi_epu16(_mm256_packus_epi32(v2, v3), scale);
+            // 两次 pack 都在 128 位通道内交错，按 4 个样本一组重排回顺序
+            const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(a, b), order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), packed);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128i low = _mm_set1_epi32(static_cast<int>(low32));
+        const __m128i range = _mm_set1_epi32(static_cast<int>(range32));
+        const __m128i shift = _mm_cvtsi32_si128(shift32);
+        const __m128i scale = _mm_set1_epi16(static_cast<short>(scale32));
+        for (; k + 16 <= count; k += 16) {
+            const __m128i* in = reinterpret_cast<const __m128i*>(src + 4 * k);
+            const __m128i v0 = reduce32(_mm_loadu_si128(in), low, range, shift);
+            const __m128i v1 = reduce32(_mm_loadu_si128(in + 1), low, range, shift);
+            const __m128i v2 = reduce32(_mm_loadu_si128(in + 2), low, range, shift);
+            const __m128i v3 = reduce32(_mm_loadu_si128(in + 3), low, range, shift);
+            const __m128i a = _mm_mulhi_epu16(packU16(v0, v1), scale);
+            const __m128i b = _mm_mulhi_epu16(packU16(v2, v3), scale);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + k), _mm_packus_epi16(a, b));
+        }
+    }
+#endif
+    for (; k < count; ++k) {
+        const uint32_t x = qFromLittleEndian<quint32>(src + 4 * k);
+        const uint32_t v = qMin(x > low32 ? x - low32 : 0u, range32) >> shift32;
+        dst[k] = static_cast<uint8_t>(qMin((v * scale32) >> 16, 255u));
+    }
+}
+
+void SampleConverter::convert(const uint8_t* src, int bytesPerSample, uint8_t* dst, int count) const
+{
+    switch (bytesPerSample) {
+    case 1: std::memcpy(dst, src, count); break;
+    case 2: convert16(src, dst, count); break;
+    case 4: convert32(src, dst, count); break;
+    default: std::memset(dst, 0, count); break;
+    }
+}
+
+// 保留的原始样本按本机字节序存放（x86/ARM 均为小端），可以直接当作小端字节流
+void SampleConverter::convertMatrix(const PingMatrix16& src, PingMatrix& dst) const
+{
+    dst.clear();
+    dst.reserve(src.rows(), src.totalSamples());
+    for (int i = 0; i < src.rows(); ++i) {
+        const int n = src.rowSize(i);
+        convert16(reinterpret_cast<const uint8_t*>(src.row(i)), dst.appendRow(n), n);
+    }
+}
+
+void SampleConverter::convertMatrix(const PingMatrix32& src, PingMatrix& dst) const
+{
+    dst.clear();
+    dst.reserve(src.rows(), src.totalSamples());
+    for (int i = 0; i < src.rows(); ++i) {
+        const int n = src.rowSize(i);
+        convert32(reinterpret_cast<const uint8_t*>(src.row(i)), dst.appendRow(n), n);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SAMPLECONVERTER_H
+#define SAMPLECONVERTER_H
+
+#include <QVector>
+#include <cstdint>
+#include "pingmatrix.h"
+
+// 16/32 位样本映射到 8 位显示灰度的方式
+struct SampleMapping {
+    enum Mode {
+        Linear,     // 按位深的满量程线性映射：16 位为 32768（与原来 255*x/32768 一致），32 位为 2^31
+        Log,        // [low, high] 窗口内对数压缩，适合动态范围大的数据
+        Clip        // 只线性拉伸 [low, high] 窗口，窗口外饱和
+    };
+
+    Mode mode = Linear;
+    double low = 0.0;           // Log / Clip 的窗口，单位为原始样本值
+    double high = 65535.0;
+};
+
+// 把原始位深样本转换成 8 位：线性/窗口映射用 SSE2（qmake CONFIG+=avx2 时用 AVX2）定点运算，
+// 32 位样本先右移到 16 位以内再用同样的定点乘法；16 位的对数映射或窗口过窄时查 65536 项的表
+class SampleConverter
+{
+public:
+    explicit SampleConverter(const SampleMapping& mapping = SampleMapping());
+
+    const SampleMapping& mapping() const { return map; }
+
+    // src 为小端字节流，不要求对齐
+    void convert16(const uint8_t* src, uint8_t* dst, int count) const;
+    void convert32(const uint8_t* src, uint8_t* dst, int count) const;
+
+    // 按 bytesPerSample 分派，1 字节直接拷贝
+    void convert(const uint8_t* src, int bytesPerSample, uint8_t* dst, int count) const;
+
+    // 从保留的原始样本重新生成 8 位矩阵，不需要重新解析文件
+    void convertMatrix(const PingMatrix16& src, PingMatrix& dst) const;
+    void convertMatrix(const PingMatrix32& src, PingMatrix& dst) const;
+
+private:
+    SampleMapping map;
+    uint32_t low16 = 0;         // 定点参数：y = (min(x - low, range) * scale) >> 16
+    uint32_t range16 = 0;
+    uint32_t scale16 = 0;
+    QVector<uint8_t> lut16;     // 非线性或窗口过窄时使用
+    uint32_t low32 = 0;         // 定点参数：y = ((min(x - low, range) >> shift) * scale) >> 16
+    uint32_t range32 = 1;
+    int shift32 = 0;
+    uint32_t scale32 = 0;       // 为 0 时窗口不足 256，逐点精确计算
+};
+
+#endif // SAMPLECONVERTER_H
@@ -0,0 +1,252 @@
+#include "slantrangecorrector.h"
+#include "sonogramgenerator.h"
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int ScaleBins = 1024;     // 样点间距比按 1/1024 分箱
+
+// 每个 ping 一侧的重采样参数
+struct SideJob {
+    int altitude = -1;      // 水线距正下方的样点数，< 0 表示跳过
+    int scaleBin = 0;
+    const QVector<qint32>* positions = nullptr;
+};
+
+// 有效样点间距的中位数，没有时返回 0
+double medianSpacing(const PingMetaTable& meta)
+{
+    std::vector<double> spacing;
+    spacing.reserve(meta.size());
+    for (int ping = 0; ping < meta.size(); ++ping) {
+        if (meta.metersPerSample(ping) > 0.0) spacing.push_back(meta.metersPerSample(ping));
+    }
+    if (spacing.empty()) return 0.0;
+    std::nth_element(spacing.begin(), spacing.begin() + spacing.size() / 2, spacing.end());
+    return spacing[spacing.size() / 2];
+}
+
+}
+
+SlantRangeCorrector::SlantRangeCorrector()
+{
+}
+
+quint64 SlantRangeCorrector::tableKey(int altitudeSamples, int scaleBin)
+{
+    return (static_cast<quint64>(static_cast<quint32>(altitudeSamples)) << 32) | static_cast<quint32>(scaleBin);
+}
+
+void SlantRangeCorrector::fillTable(quint64 key, int width, RangeTable &positions)
+{
+    // 斜距样点位置 j = sqrt((k * scale)² + h²)，scale 为输出分辨率与本 ping 样点间距之比
+    const int altitude = static_cast<int>(key >> 32);
+    const double scale = static_cast<double>(static_cast<quint32>(key)) / ScaleBins;
+    const double h2 = static_cast<double>(altitude) * altitude;
+    positions.resize(width);
+    for (int k = 0; k < width; ++k) {
+        const double x = k * scale;
+        positions[k] = static_cast<qint32>(std::min(std::sqrt(x * x + h2) * 65536.0, 2147483647.0));
+    }
+}
+
+TiledImage SlantRangeCorrector::correct(const PingMatrix &portData, const PingMatrix &starboardData,
+                                        const QVector<int> &portBottom, const QVector<int> &starboardBottom,
+                                        const PingMetaTable &meta)
+{
+    if (portData.isEmpty() || starboardData.isEmpty()) return TiledImage();
+    if (portBottom.size() != portData.rows() || starboardBottom.size() != starboardData.rows()) return TiledImage();
+
+    const int numPings = qMin(portData.rows(), starboardData.rows());
+    // 与底图布局相同：两舷各占 sideWidth 列，正下方在中间
+    const int leftWidth = SonogramGenerator::sideWidth(&portData, &starboardData);
+    const int rightWidth = leftWidth;
+    const int totalWidth = leftWidth + rightWidth;
+    if (tableWidth != leftWidth) {
+        tables.clear();
+        tableWidth = leftWidth;
+    }
+
+    // 输出分辨率取样点间距的中位数，个别异常 ping 不会拉低整幅图的分辨率；
+    // 图像宽度与原图相同，间距比中位数大的 ping 超出宽度的部分截掉
+    const double outSpacing = medianSpacing(meta);
+    auto spacingOf = [&](int ping) {
+        const double s = ping < meta.size() ? meta.metersPerSample(ping) : 0.0;
+        return s > 0.0 ? s : outSpacing;
+    };
+
+    // 第一遍：确定每个 ping 用哪张映射表，缺的表并行生成
+    QVector<SideJob> portJobs(numPings), starboardJobs(numPings);
+    QVector<QPair<quint64, RangeTable*>> missing;
+    auto plan = [&](SideJob& job, int altitude, int sampleCount, int ping) {
+        if (sampleCount <= 0 || altitude < 0 || altitude >= sampleCount) return;
+        const double spacing = spacingOf(ping);
+        job.altitude = altitude;
+        job.scaleBin = spacing > 0.0 && outSpacing > 0.0
+                ? static_cast<int>(qBound(1.0, std::round(outSpacing / spacing * ScaleBins), 1048576.0))
+                : ScaleBins;
+        const quint64 key = tableKey(job.altitude, job.scaleBin);
+        if (!tables.contains(key)) {
+            missing.append(qMakePair(key, static_cast<RangeTable*>(nullptr)));
+            tables.insert(key, RangeTable());
+        }
+    };
+    for (int ping = 0; ping < numPings; ++ping) {
+        const int portSize = portData.rowSize(ping);
+        // 左舷水线为零值区起点，距行尾（正下方）的样点数即高度
+        plan(portJobs[ping], portBottom[ping] > 0 ? portSize - portBottom[ping] : -1, portSize, ping);
+        plan(starboardJobs[ping], starboardBottom[ping] > 0 ? starboardBottom[ping] : -1, starboardData.rowSize(ping), ping);
+    }
+    // 插入结束后再取各表地址，生成时各任务只写自己的表，不改动 QHash 结构
+    for (auto& entry : missing) entry.second = &tables[entry.first];
+    const int width = tableWidth;
+    QtConcurrent::blockingMap(missing, [width](QPair<quint64, RangeTable*>& entry) {
+        fillTable(entry.first, width, *entry.second);
+    });
+    for (int ping = 0; ping < numPings; ++ping) {
+        SideJob& port = portJobs[ping];
+        SideJob& starboard = starboardJobs[ping];
+        if (port.altitude >= 0) port.positions = &tables.constFind(tableKey(port.altitude, port.scaleBin)).value();
+        if (starboard.altitude >= 0) starboard.positions = &tables.constFind(tableKey(starboard.altitude, starboard.scaleBin)).value();
+    }
+
+    // 第二遍：先分配好所有条带，各 ping 按行块并行直接写入输出行
+    const int tileRows = TiledImage::rowsPerTileFor(totalWidth);
+    QVector<QImage> tiles((numPings + tileRows - 1) / tileRows);
+    QVector<uchar*> tileBits(tiles.size());
+    for (int i = 0; i < tiles.size(); ++i) {
+        tiles[i] = QImage(totalWidth, qMin(tileRows, numPings - i * tileRows), QImage::Format_Grayscale8);
+        tiles[i].fill(Qt::white);
+        tileBits[i] = tiles[i].bits();
+    }
+    const qint64 bytesPerLine = tiles.isEmpty() ? 0 : tiles.first().bytesPerLine();
+
+    QVector<QPair<int, int>> ranges;
+    const int chunkCount = QThreadPool::globalInstance()->maxThreadCount() * 4;
+    const int chunkSize = qMax(1, (numPings + chunkCount - 1) / chunkCount);
+    for (int begin = 0; begin < numPings; begin += chunkSize) {
+        ranges.append(qMakePair(begin, qMin(numPings, begin + chunkSize)));
+    }
+    QtConcurrent::blockingMap(ranges, [&](const QPair<int, int>& range) {
+        for (int ping = range.first; ping < range.second; ++ping) {
+            uchar* line = tileBits[ping / tileRows] + (ping % tileRows) * bytesPerLine;
+            const SideJob& port = portJobs[ping];
+            const SideJob& starboard = starboardJobs[ping];
+            if (port.positions) {
+                // 左舷从中间往左写
+                resampleRow(portData.row(ping), portData.rowSize(ping), true,
+                            port.positions->constData(), leftWidth, line + leftWidth - 1, -1);
+            }
+            if (starboard.positions) {
+                resampleRow(starboardData.row(ping), starboardData.rowSize(ping), false,
+                            starboard.positions->constData(), rightWidth, line + leftWidth, 1);
+            }
+        }
+    });
+
+    TiledImage result;
+    for (const QImage& tile : tiles) {
+        result.append(tile);
+    }
+    return result;
+}
+
+void SlantRangeCorrector::resampleRow(const uint8_t *samples, int sampleCount, bool nadirAtEnd,
+                                      const qint32 *positions, int count, uchar *dst, int dstStep)
+{
+    if (sampleCount < 2) return;
+
+    // 只输出斜距落在样本范围内的像素（位置单调递增，二分找到末尾）
+    const qint32 limit = static_cast<qint32>(qMin<qint64>(static_cast<qint64>(sampleCount - 1) << 16, 2147483647));
+    count = static_cast<int>(std::lower_bound(positions, positions + count, limit) - positions);
+
+    auto pixel = [&](int k) {
+        const int j = positions[k] >> 16;
+        const int frac = positions[k] & 0xFFFF;
+        const int nearIdx = nadirAtEnd ? sampleCount - 1 - j : j;
+        const int farIdx = nadirAtEnd ? nearIdx - 1 : nearIdx + 1;
+        const int value = (samples[nearIdx] * (0x10000 - frac) + samples[farIdx] * frac + 0x8000) >> 16;
+        dst[k * dstStep] = static_cast<uchar>(qMin(255 - value, static_cast<int>(TiledImage::MaxDataGray)));
+    };
+
+    int k = 0;
+#if defined(__AVX2__)
+    // 8 个像素一组：每个位置按 32 位收集相邻两个样本，定点线性插值。
+    // 收集会多读 2 个字节，靠近行首/行尾的组退回逐点处理
+    const __m256i fracMask = _mm256_set1_epi32(0xFFFF);
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i full = _mm256_set1_epi32(0x10000);
+    const __m256i round = _mm256_set1_epi32(0x8000);
+    const __m256i portBase = _mm256_set1_epi32(sampleCount - 2);
+    const int* base = reinterpret_cast<const int*>(samples);
+    alignas(32) int out[8];
+    for (; k + 8 <= count; k += 8) {
+        const int minWhole = positions[k] >> 16;
+        const int maxWhole = positions[k + 7] >> 16;
+        const bool safe = nadirAtEnd ? (minWhole >= 2 && maxWhole <= sampleCount - 2)
+                                     : maxWhole + 4 <= sampleCount;
+        if (!safe) {
+            for (int i = 0; i < 8; ++i) pixel(k + i);
+            continue;
+        }
+        const __m256i pos = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(positions + k));
+        const __m256i whole = _mm256_srli_epi32(pos, 16);
+        // 右舷从 s[j] 收集，低两字节为 (s[j], s[j+1])；
+        // 左舷第 j 个样点在行中下标为 n-1-j，从 n-2-j 收集，低两字节为 (s[n-2-j], s[n-1-j])
+        const __m256i index = nadirAtEnd ? _mm256_sub_epi32(portBase, whole) : whole;
+        const __m256i words = _mm256_i32gather_epi32(base, index, 1);
+        const __m256i low = _mm256_and_si256(words, byteMask);
+        const __m256i high = _mm256_and_si256(_mm256_srli_epi32(words, 8), byteMask);
+        const __m256i nearValue = nadirAtEnd ? high : low;
+        const __m256i farValue = nadirAtEnd ? low : high;
+        const __m256i frac = _mm256_and_si256(pos, fracMask);
+        __m256i value = _mm256_add_epi32(_mm256_mullo_epi32(nearValue, _mm256_sub_epi32(full, frac)),
+                                         _mm256_mullo_epi32(farValue, frac));
+        value = _mm256_srli_epi32(_mm256_add_epi32(value, round), 16);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(out), value);
+        for (int i = 0; i < 8; ++i) {
+            dst[(k + i) * dstStep] = static_cast<uchar>(qMin(255 - out[i], static_cast<int>(TiledImage::MaxDataGray)));
+        }
+    }
+#elif defined(__SSE2__)
+    // 8 个像素一组：SSE2 没有收集指令，相邻两个样本逐点取出；插值改写为
+    // near + (((far - near) * frac + 0x8000) >> 16)，用 16 位乘法算出，与逐点结果相同
+    alignas(16) short nearBuf[8], farBuf[8], fracBuf[8];
+    alignas(16) uchar out[16];
+    const __m128i white = _mm_set1_epi16(255);
+    const __m128i maxData = _mm_set1_epi16(TiledImage::MaxDataGray);
+    for (; k + 8 <= count; k += 8) {
+        for (int i = 0; i < 8; ++i) {
+            const int j = positions[k + i] >> 16;
+            const int nearIdx = nadirAtEnd ? sampleCount - 1 - j : j;
+            nearBuf[i] = samples[nearIdx];
+            farBuf[i] = samples[nadirAtEnd ? nearIdx - 1 : nearIdx + 1];
+            fracBuf[i] = static_cast<short>(positions[k + i] & 0xFFFF);
+        }
+        const __m128i nearValue = _mm_load_si128(reinterpret_cast<const __m128i*>(nearBuf));
+        const __m128i diff = _mm_sub_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(farBuf)), nearValue);
+        const __m128i frac = _mm_load_si128(reinterpret_cast<const __m128i*>(fracBuf));
+        // diff * frac 的高 16 位：frac 按有符号数相乘，frac >= 0x8000 的通道再补上 diff；
+        // 低 16 位加 0x8000 的进位即低 16 位的最高位
+        __m128i high = _mm_mulhi_epi16(diff, frac);
+        high = _mm_add_epi16(high, _mm_and_si128(diff, _mm_srai_epi16(frac, 15)));
+        const __m128i carry = _mm_srli_epi16(_mm_mullo_epi16(diff, frac), 15);
+        const __m128i value = _mm_add_epi16(_mm_add_epi16(nearValue, high), carry);
+        const __m128i inverted = _mm_min_epi16(_mm_sub_epi16(white, value), maxData);
+        _mm_store_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(inverted, inverted));
+        for (int i = 0; i < 8; ++i) {
+            dst[(k + i) * dstStep] = out[i];
+        }
+    }
+#endif
+    for (; k < count; ++k) pixel(k);
+}
@@ -0,0 +1,52 @@
+#ifndef SLANTRANGECORRECTOR_H
+#define SLANTRANGECORRECTOR_H
+
+#include <QHash>
+#include <QVector>
+#include <cstdint>
+#include "pingmatrix.h"
+#include "pingmeta.h"
+#include "tiledimage.h"
+
+// 斜距到地距的几何重采样：输出第 k 个像素的地距为 k * 输出分辨率，对应斜距
+// sqrt(地距² + 高度²)，高度由水线位置换算。每个 ping 的样点间距取自 PingMeta（声速 × 采样间隔）。
+// 地距 → 斜距样点位置只取决于高度（样点数）和样点间距与输出分辨率之比，
+// 按这两个量分箱缓存映射表，同一条测线上大量 ping 共用少数几张表
+class SlantRangeCorrector
+{
+public:
+    // 算法或输出几何有改动时加一，磁盘缓存的旧矫正图随之失效
+    // （2：输出分辨率改用样点间距中位数；3：两舷等宽，与底图布局相同，数据像素不用补白灰度）
+    static const int Version = 3;
+
+    SlantRangeCorrector();
+
+    // portBottom / starboardBottom 为 BottomTracker 给出的水线（左舷行尾、右舷行首为正下方），
+    // meta 与 ping 序号对齐；样点间距无效的 ping 用整条测线的中位数，全部无效时按等间距处理。
+    // 输出为 Grayscale8 条带，布局与底图相同（两舷各占 SonogramGenerator::sideWidth 列，正下方在中间），
+    // 反色显示，斜距范围之外为补白
+    TiledImage correct(const PingMatrix& portData, const PingMatrix& starboardData,
+                       const QVector<int>& portBottom, const QVector<int>& starboardBottom,
+                       const PingMetaTable& meta);
+
+    // 已缓存的映射表数
+    int cachedTables() const { return tables.size(); }
+    void clearCache() { tables.clear(); }
+
+private:
+    // 地距像素 → 斜距样点位置（距正下方的样点数，16.16 定点）
+    typedef QVector<qint32> RangeTable;
+
+    static quint64 tableKey(int altitudeSamples, int scaleBin);
+    static void fillTable(quint64 key, int width, RangeTable& positions);
+
+    // 按映射表从一行样本插值出 count 个地距像素并反色写入 dst。
+    // nadirAtEnd 为 true 时样本正下方在行尾（左舷）；dst 指向输出中正下方的像素，按 dstStep 往外写
+    static void resampleRow(const uint8_t* samples, int sampleCount, bool nadirAtEnd,
+                            const qint32* positions, int count, uchar* dst, int dstStep);
+
+    QHash<quint64, RangeTable> tables;
+    int tableWidth = 0;
+};
+
+#endif // SLANTRANGECORRECTOR_H
@@ -2,7 +2,10 @@
 #define SLANTRANGEDIALOG_H
 
 #include <QDialog>
-#include <QGraphicsScene>
+#include "sonardataset.h"
+#include "enhancementpipeline.h"
+#include "bottomtracker.h"
+#include "slantrangecorrector.h"
 
 namespace Ui {
 class SlantRangeDialog;
@@ -17,43 +20,51 @@ public:
     ~SlantRangeDialog();
 
     //获取原始数据图像
-    void setData(const QVector<std::vector<uint8_t>> &port, const QVector<std::vector<uint8_t>> &starboard, const QImage &img);
+    void setData(const SonarDatasetPtr& data);
 
 private:
     Ui::SlantRangeDialog *ui;
 
-    QGraphicsScene *scene;
-    QGraphicsPixmapItem *imageItem = nullptr;
-
-    QVector<std::vector<uint8_t>> portDataAll, starboardDataAll;
-    QImage originalImage, currentImage;
+    SonarDatasetPtr dataset;   // 与主窗口共享，只读
 
     //水线
     QVector<int> portLine;
     QVector<int> starboardLine;
 
     bool slantCorrected = false; // 当前是否处于斜距矫正状态
-    QImage correctedCache;           // 缓存的斜距矫正图
+    TiledImage correctedCache;       // 缓存的斜距矫正图
+
+    // 依次叠加的增强操作，复合成查找表后只更新颜色表，基准图不变
+    EnhancementPipeline pipeline;
+    TiledImage claheImage;           // CLAHE 不是逐点操作，结果单独保存
+    qint64 baseHistogram[256];
+    bool histogramReady = false;
 
 private slots:
     void on_horizontalSlider_valueChanged(int value);
     void on_HistogramEqualizeBtn_clicked();
     void on_slantRangeCorrected_clicked();
+    void on_altitudeSeededCheckBox_toggled(bool checked);
     void on_StretchIntenistyBtn_clicked();
     void on_NegativeBtn_clicked();
     void on_RestoreBtn_clicked();
+    void on_ClaheBtn_clicked();
 
 private:
     void updateView();
-    void fitToWidth(QGraphicsView *view, const QImage &image);
-
-    void showEvent(QShowEvent *event) override;
+    // 既没有斜距矫正也没有 CLAHE 时直接按 ping 矩阵显示数据集，不生成整幅声图
+    bool showsDataset() const { return !slantCorrected && claheImage.isEmpty(); }
+    // 当前是否有可显示的数据
+    bool hasBase() const;
+    // 当前显示的像素：CLAHE 结果、斜距矫正图，或按需生成的原始声图
+    TiledImage baseImage() const;
+    // 丢掉 CLAHE 结果，回到原始数据或斜距矫正图
+    void resetToSource();
+    void updateColorTable();
 
     void doBottomTrack();
-    //寻找合适的开始位置
-    int findAppropriateStartIdx(const std::vector<uint8_t>& samples, int startIdx);
-    //移动平均平滑水线点
-    QVector<int> smoothLine(const QVector<int>& line, int window = 50);
+    BottomTracker tracker;
+    SlantRangeCorrector corrector;   // 地距映射表在多次矫正间复用
 
 };
 
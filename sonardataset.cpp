@@ -0,0 +1,67 @@
+#include "sonardataset.h"
+#include "sonogramgenerator.h"
+#include <QMutexLocker>
+
+SonarDataset::SonarDataset(PingMatrix port, PingMatrix starboard, NativeSamples native, PingMetaTable meta)
+    : portData(std::move(port))
+    , starboardData(std::move(starboard))
+    , nativeData(std::move(native))
+    , metaData(std::move(meta))
+{
+}
+
+TiledImage SonarDataset::baseSonogram() const
+{
+    QMutexLocker locker(&sonogramMutex);
+    if (sonogramCache.isEmpty() && !isEmpty()) {
+        SonogramGenerator generator;
+        sonogramCache = generator.createTiledSonogram(portData, starboardData);
+    }
+    return sonogramCache;
+}
+
+void SonarDataset::setDecodeSettings(quint64 channelMask, const SampleMapping &mapping)
+{
+    decodeKey = ":mask=" + QByteArray::number(channelMask, 16)
+                + ":map=" + QByteArray::number(static_cast<int>(mapping.mode))
+                + "," + QByteArray::number(mapping.low, 'g', 17)
+                + "," + QByteArray::number(mapping.high, 'g', 17);
+}
+
+ProductCache SonarDataset::productCache() const
+{
+    QMutexLocker locker(&productMutex);
+    if (!productChecked) {
+        productChecked = true;
+        const QByteArray fingerprint = sourcePath.isEmpty() ? QByteArray() : ProductCache::fingerprint(sourcePath);
+        // 中途取消的读取只有部分 ping，ping 数也作为键的一部分；解析设置不同时数据也不同
+        if (!fingerprint.isEmpty())
+            products = ProductCache(fingerprint + ":" + QByteArray::number(portData.rows())
+                                    + ":" + QByteArray::number(starboardData.rows()) + decodeKey);
+    }
+    return products;
+}
+
+bool SonarDataset::remap(const SampleMapping &mapping, PingMatrix &port, PingMatrix &starboard) const
+{
+    if (!hasNativeSamples()) return false;
+
+    SampleConverter converter(mapping);
+    if (nativeData.bytesPerSample == 2) {
+        converter.convertMatrix(nativeData.port16, port);
+        converter.convertMatrix(nativeData.starboard16, starboard);
+    } else {
+        converter.convertMatrix(nativeData.port32, port);
+        converter.convertMatrix(nativeData.starboard32, starboard);
+    }
+    return true;
+}
+
+TiledImage SonarDataset::remappedSonogram(const SampleMapping &mapping) const
+{
+    PingMatrix port, starboard;
+    if (!remap(mapping, port, starboard)) return TiledImage();
+
+    SonogramGenerator generator;
+    return generator.createTiledSonogram(port, starboard);
+}
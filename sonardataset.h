@@ -0,0 +1,71 @@
+#ifndef SONARDATASET_H
+#define SONARDATASET_H
+
+#include "tiledimage.h"
+#include <QMutex>
+#include <QSharedPointer>
+#include "pingmatrix.h"
+#include "sampleconverter.h"
+#include "pingmeta.h"
+#include "productcache.h"
+
+// 一条测线解析后的只读数据：左右舷 ping 矩阵 + 缓存的底图。
+// 主窗口和各个对话框通过 SonarDatasetPtr 共享同一份，不再各自深拷贝。
+// 发布后不再修改；跟随写入时每次追上写入进度都发布一份新的数据集
+class SonarDataset
+{
+public:
+    SonarDataset(PingMatrix port, PingMatrix starboard, NativeSamples native = NativeSamples(),
+                 PingMetaTable meta = PingMetaTable());
+
+    SonarDataset(const SonarDataset&) = delete;
+    SonarDataset& operator=(const SonarDataset&) = delete;
+
+    const PingMatrix& port() const { return portData; }
+    const PingMatrix& starboard() const { return starboardData; }
+
+    int pingCount() const { return qMax(portData.rows(), starboardData.rows()); }
+    bool isEmpty() const { return portData.isEmpty() && starboardData.isEmpty(); }
+
+    // 来源文件，在共享给对话框之前设置；用来定位派生产品的磁盘缓存
+    void setSourceFile(const QString& path) { sourcePath = path; }
+    const QString& sourceFile() const { return sourcePath; }
+    // 解析时的通道掩码和 8 位映射，同一文件按不同设置解析出的数据不共用产品缓存
+    void setDecodeSettings(quint64 channelMask, const SampleMapping& mapping);
+    // 按源文件内容指纹和 ping 数定位的产品缓存，第一次调用时计算指纹；没有来源文件时不可用
+    ProductCache productCache() const;
+
+    // 每个 ping 的参数（时间、位置、航向、速度、高度、声速、采样间隔、斜距），按列存放，
+    // 与 ping 序号对齐，可能为空
+    const PingMetaTable& pingMeta() const { return metaData; }
+
+    // 左右舷拼接的底图，第一次调用时生成，之后直接返回缓存（条带为 QImage，隐式共享，拷贝不复制像素）
+    TiledImage baseSonogram() const;
+
+    // 解析时保留的 16/32 位原始样本（8 位文件或未开启保留时为空）
+    bool hasNativeSamples() const { return !nativeData.isEmpty(); }
+    const NativeSamples& nativeSamples() const { return nativeData; }
+
+    // 用新的映射从原始样本重新生成 8 位数据 / 底图，没有原始样本时返回 false / 空图
+    bool remap(const SampleMapping& mapping, PingMatrix& port, PingMatrix& starboard) const;
+    TiledImage remappedSonogram(const SampleMapping& mapping) const;
+
+private:
+    PingMatrix portData;
+    PingMatrix starboardData;
+    NativeSamples nativeData;
+    PingMetaTable metaData;
+
+    QString sourcePath;
+    QByteArray decodeKey;
+
+    mutable QMutex sonogramMutex;
+    mutable TiledImage sonogramCache;
+    mutable QMutex productMutex;
+    mutable bool productChecked = false;
+    mutable ProductCache products;
+};
+
+typedef QSharedPointer<const SonarDataset> SonarDatasetPtr;
+
+#endif // SONARDATASET_H
@@ -1,112 +1,274 @@
 #include "sonogramgenerator.h"
+#include "enhancementpipeline.h"
 #include <QtMath>
-#include <QPainter>
 #include <QDebug>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 SonogramGenerator::SonogramGenerator()
 {
 }
 
-QImage SonogramGenerator::createSonogram(const QVector<std::vector<uint8_t>>& portData,
-                                         const QVector<std::vector<uint8_t>>& starboardData,
-                                         bool combine)
+int SonogramGenerator::sideWidth(const PingMatrix *portData, const PingMatrix *starboardData)
 {
-    // 将左右舷分别转成 QImage
-    QImage portImg = vectorToImage(portData);
-    QImage starImg = vectorToImage(starboardData);
+    return qMax(portData ? portData->maxRowSize() : 0, starboardData ? starboardData->maxRowSize() : 0);
+}
 
-    if (!combine) {
-        // 只返回左舷，调试用
-        return portImg;
+TiledImage SonogramGenerator::createTiledSonogram(const PingMatrix &portData, const PingMatrix &starboardData)
+{
+    TiledImage tiles;
+    const int width = sideWidth(&portData, &starboardData);
+    const int height = qMax(portData.rows(), starboardData.rows());
+    if (width == 0 || height == 0) return tiles;
+
+    // 按条带生成，每次只占用一个条带大小的临时内存
+    const int tileRows = TiledImage::rowsPerTileFor(static_cast<qint64>(width) * 2);
+    for (int first = 0; first < height; first += tileRows) {
+        tiles.append(combineRows(portData, starboardData, first, qMin(tileRows, height - first)));
     }
+    return tiles;
+}
 
-    if (portImg.isNull() && starImg.isNull()) return QImage();
+QImage SonogramGenerator::combineRows(const PingMatrix &portData, const PingMatrix &starboardData, int firstRow, int rowCount)
+{
+    if ((portData.isEmpty() && starboardData.isEmpty()) || rowCount <= 0) return QImage();
 
-    int width = qMax(portImg.width(), starImg.width());
-    int height = qMax(portImg.height(), starImg.height());
+    // 左右舷各占 width 列，直接反色写入同一张图的扫描行，不再经过每舷的中间图和 QPainter
+    const int width = sideWidth(&portData, &starboardData);
+    QImage combined(width * 2, rowCount, QImage::Format_Grayscale8);
 
-    // 创建一个大图，把左右拼接在一起
-    QImage combined(width * 2, height, QImage::Format_Grayscale8);
-    combined.fill(Qt::white);
+    for (int y = 0; y < rowCount; ++y) {
+        uchar* line = combined.scanLine(y);
+        writeInvertedRow(portData, firstRow + y, line, width);
+        writeInvertedRow(starboardData, firstRow + y, line + width, width);
+    }
+    return combined;
+}
 
-    QPainter painter(&combined);
-    painter.drawImage(0, 0, portImg);
-    painter.drawImage(width, 0, starImg);
-    painter.end();
+void SonogramGenerator::writeInvertedRow(const PingMatrix &data, int ping, uchar *dst, int width)
+{
+    const int rowSize = ping < data.rows() ? qMin(data.rowSize(ping), width) : 0;
+    if (rowSize > 0) invertRow(data.row(ping), dst, rowSize);   //颜色反转
+    if (rowSize < width) std::memset(dst + rowSize, TiledImage::PaddingGray, width - rowSize);   // 短行补白
+}
 
-    return combined;
+void SonogramGenerator::invertRow(const uint8_t *src, uchar *dst, int count)
+{
+    // 8 位样本 255 - x 等于按位取反；零样本取 MaxDataGray，与补白区分
+    int x = 0;
+#if defined(__AVX2__)
+    const __m256i ones256 = _mm256_set1_epi8(static_cast<char>(0xFF));
+    const __m256i maxData256 = _mm256_set1_epi8(static_cast<char>(TiledImage::MaxDataGray));
+    for (; x + 32 <= count; x += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                            _mm256_min_epu8(_mm256_xor_si256(v, ones256), maxData256));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i ones = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i maxData = _mm_set1_epi8(static_cast<char>(TiledImage::MaxDataGray));
+    for (; x + 16 <= count; x += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_min_epu8(_mm_xor_si128(v, ones), maxData));
+    }
+#endif
+    for (; x < count; ++x) {
+        dst[x] = static_cast<uchar>(qMin(255 - src[x], static_cast<int>(TiledImage::MaxDataGray)));
+    }
 }
 
-QImage SonogramGenerator::vectorToImage(const QVector<std::vector<uint8_t>>& data)
+namespace {
+
+// 一个行块：统计直方图时每块各自计数，最后再合并
+struct RowBand {
+    int first = 0;
+    int count = 0;
+    qint64 hist[256] = {0};
+};
+
+const int MinBandRows = 64;     // 行块太小时线程调度开销比计算还大
+
+}
+
+void SonogramGenerator::forEachBand(int rows, const std::function<void(int, int)> &op)
 {
-    if (data.isEmpty()) return QImage();
+    if (rows <= 0) return;
+
+    // 每个线程分几块，负载更均匀
+    const int chunkCount = QThreadPool::globalInstance()->maxThreadCount() * 4;
+    const int bandRows = qMax(MinBandRows, (rows + chunkCount - 1) / chunkCount);
+    if (bandRows >= rows) {
+        op(0, rows);
+        return;
+    }
 
-    int height = data.size();
-    int width  = data[0].size();
+    QVector<QPair<int, int>> bands;
+    for (int first = 0; first < rows; first += bandRows) {
+        bands.append(qMakePair(first, qMin(bandRows, rows - first)));
+    }
+    QtConcurrent::blockingMap(bands, [&op](const QPair<int, int>& band) {
+        op(band.first, band.second);
+    });
+}
 
-    QImage img(width, height, QImage::Format_Grayscale8);
+void SonogramGenerator::accumulateHistogram(const QImage &gray, qint64 hist[256])
+{
+    const int width = gray.width();
+    const int rows = gray.height();
+    const int chunkCount = QThreadPool::globalInstance()->maxThreadCount() * 4;
+    const int bandRows = qMax(MinBandRows, (rows + chunkCount - 1) / chunkCount);
+
+    QVector<RowBand> bands;
+    for (int first = 0; first < rows; first += bandRows) {
+        RowBand band;
+        band.first = first;
+        band.count = qMin(bandRows, rows - first);
+        bands.append(band);
+    }
 
-    for (int y = 0; y < height; ++y) {
-        const std::vector<uint8_t>& row = data[y];
-        for (int x = 0; x < width; ++x) {
-            uint8_t val = 255 - row[x]; //颜色反转
-            img.setPixel(x, y, qRgb(val, val, val));
+    auto countBand = [&gray, width](RowBand& band) {
+        for (int y = band.first; y < band.first + band.count; ++y) {
+            const uchar* line = gray.constScanLine(y);
+            for (int x = 0; x < width; ++x) {
+                band.hist[line[x]]++;
+            }
         }
+    };
+    if (bands.size() > 1) {
+        QtConcurrent::blockingMap(bands, countBand);
+    } else if (!bands.isEmpty()) {
+        countBand(bands.first());
     }
 
-    // return img.mirrored(false, true); // Y 轴翻转，让ping顺序符合常见显示习惯
-    return img;
+    // 合并各行块的计数，补白不计入
+    for (const RowBand& band : bands) {
+        for (int i = 0; i < TiledImage::PaddingGray; ++i) {
+            hist[i] += band.hist[i];
+        }
+    }
 }
 
-QImage SonogramGenerator::applyGamma(const QImage& src, double gamma)
+void SonogramGenerator::accumulateHistogram(const TiledImage &gray, qint64 hist[256])
 {
-    if (src.isNull()) return QImage();
+    for (int i = 0; i < gray.tileCount(); ++i) {
+        accumulateHistogram(gray.tile(i).convertToFormat(QImage::Format_Grayscale8), hist);
+    }
+}
 
-    QImage result = src.convertToFormat(QImage::Format_Grayscale8);
+void SonogramGenerator::accumulateHistogram(const PingMatrix &data, qint64 hist[256])
+{
+    const int rows = data.rows();
+    const int chunkCount = QThreadPool::globalInstance()->maxThreadCount() * 4;
+    const int bandRows = qMax(MinBandRows, (rows + chunkCount - 1) / chunkCount);
+
+    QVector<RowBand> bands;
+    for (int first = 0; first < rows; first += bandRows) {
+        RowBand band;
+        band.first = first;
+        band.count = qMin(bandRows, rows - first);
+        bands.append(band);
+    }
 
-    uchar lut[256];
-    double invGamma = 1.0 / gamma;
-    for (int i = 0; i < 256; ++i) {
-        lut[i] = static_cast<uchar>(qMin(255.0,
-                                         qPow(i / 255.0, invGamma) * 255.0));
+    // 各行样本在同一块内存里连续存放，一个行块直接按一段样本统计
+    auto countBand = [&data](RowBand& band) {
+        const uint8_t* p = data.row(band.first);
+        const uint8_t* end = data.row(band.first + band.count);    // 末行之后的偏移即样本末尾
+        for (; p < end; ++p) {
+            band.hist[qMin(255 - *p, static_cast<int>(TiledImage::MaxDataGray))]++;
+        }
+    };
+    if (bands.size() > 1) {
+        QtConcurrent::blockingMap(bands, countBand);
+    } else if (!bands.isEmpty()) {
+        countBand(bands.first());
     }
 
-    for (int y = 0; y < result.height(); ++y) {
-        uchar* line = result.scanLine(y);
-        for (int x = 0; x < result.width(); ++x) {
-            line[x] = lut[line[x]];
+    for (const RowBand& band : bands) {
+        for (int i = 0; i < 256; ++i) {
+            hist[i] += band.hist[i];
         }
     }
+}
+
+bool SonogramGenerator::histogramRange(const qint64 hist[256], int &minVal, int &maxVal)
+{
+    minVal = 0;
+    while (minVal < 256 && hist[minVal] == 0) ++minVal;
+    maxVal = 255;
+    while (maxVal >= 0 && hist[maxVal] == 0) --maxVal;
+    return minVal < maxVal;     // 空图或所有像素相同
+}
 
+QImage SonogramGenerator::applyLut(const QImage &src, const uchar lut[256])
+{
+    QImage result = src.convertToFormat(QImage::Format_Grayscale8);
+    if (result.isNull()) return result;
+
+    // 补白保持白色，数据像素映射后不超过 MaxDataGray
+    uchar table[256];
+    for (int i = 0; i < 256; ++i) table[i] = qMin(lut[i], TiledImage::MaxDataGray);
+    table[TiledImage::PaddingGray] = TiledImage::PaddingGray;
+
+    // 在当前线程取一次可写指针（必要时在这里分离），各行块按偏移各自处理
+    uchar* bits = result.bits();
+    const qint64 bytesPerLine = result.bytesPerLine();
+    const int width = result.width();
+    forEachBand(result.height(), [=](int first, int count) {
+        for (int y = first; y < first + count; ++y) {
+            uchar* line = bits + y * bytesPerLine;
+            for (int x = 0; x < width; ++x) {
+                line[x] = table[line[x]];
+            }
+        }
+    });
     return result;
 }
 
-// 直方图均衡化实现
-QImage SonogramGenerator::applyHistogramEqualization(const QImage& src)
+TiledImage SonogramGenerator::applyLut(const TiledImage &src, const uchar lut[256])
 {
-    if (src.isNull()) return QImage();
+    uchar table[256];
+    std::copy(lut, lut + 256, table);
+    return src.mapped([&table](const QImage& tile) { return applyLut(tile, table); });
+}
 
-    QImage result = src.convertToFormat(QImage::Format_Grayscale8);
+void SonogramGenerator::identityLut(uchar lut[256])
+{
+    for (int i = 0; i < 256; ++i) {
+        lut[i] = static_cast<uchar>(i);
+    }
+}
 
-    // 1. 统计直方图
-    int hist[256] = {0};
-    for (int y = 0; y < result.height(); ++y) {
-        const uchar* line = result.constScanLine(y);
-        for (int x = 0; x < result.width(); ++x) {
-            hist[line[x]]++;
-        }
+void SonogramGenerator::gammaLut(double gamma, uchar lut[256])
+{
+    double invGamma = 1.0 / gamma;
+    for (int i = 0; i < 256; ++i) {
+        lut[i] = static_cast<uchar>(qMin(255.0,
+                                         qPow(i / 255.0, invGamma) * 255.0));
     }
+}
 
-    // 2. 计算累积分布函数 (CDF)
-    int totalPixels = result.width() * result.height();
-    int cdf[256] = {0};
+void SonogramGenerator::equalizationLut(const qint64 hist[256], uchar lut[256])
+{
+    // 计算累积分布函数 (CDF)，像素数可能超过 2^31，全部用 64 位计数
+    qint64 cdf[256] = {0};
     cdf[0] = hist[0];
     for (int i = 1; i < 256; ++i) {
         cdf[i] = cdf[i-1] + hist[i];
     }
+    const qint64 totalPixels = cdf[255];
 
     // 找到第一个非零的 cdf 值
-    int cdfMin = 0;
+    qint64 cdfMin = 0;
     for (int i = 0; i < 256; ++i) {
         if (cdf[i] > 0) {
             cdfMin = cdf[i];
@@ -114,233 +276,220 @@ QImage SonogramGenerator::applyHistogramEqualization(const QImage& src)
         }
     }
 
-    // 3. 构建映射表
-    uchar lut[256];
     for (int i = 0; i < 256; ++i) {
-        lut[i] = static_cast<uchar>(
-            qRound((cdf[i] - cdfMin) * 255.0 / (totalPixels - cdfMin))
-            );
-    }
-
-    // 4. 应用映射表
-    for (int y = 0; y < result.height(); ++y) {
-        uchar* line = result.scanLine(y);
-        for (int x = 0; x < result.width(); ++x) {
-            line[x] = lut[line[x]];
-        }
+        lut[i] = totalPixels > cdfMin
+                     ? static_cast<uchar>(qRound((cdf[i] - cdfMin) * 255.0 / (totalPixels - cdfMin)))
+                     : static_cast<uchar>(i);
     }
+}
 
-    return result;
+QImage SonogramGenerator::applyGamma(const QImage& src, double gamma)
+{
+    return EnhancementPipeline().addGamma(gamma).apply(src);
 }
 
-//归一化
-// sonogramgenerator.cpp
-QImage SonogramGenerator::applyNormalize(const QImage& src)
+TiledImage SonogramGenerator::applyGamma(const TiledImage &src, double gamma)
 {
-    if (src.isNull()) return QImage();
+    return EnhancementPipeline().addGamma(gamma).apply(src);
+}
 
-    QImage result = src.convertToFormat(QImage::Format_Grayscale8);
+// 直方图均衡化实现
+QImage SonogramGenerator::applyHistogramEqualization(const QImage& src)
+{
+    return EnhancementPipeline().addEqualize().apply(src);
+}
 
-    int minVal = 255;
-    int maxVal = 0;
+TiledImage SonogramGenerator::applyHistogramEqualization(const TiledImage &src)
+{
+    return EnhancementPipeline().addEqualize().apply(src);
+}
 
-    // 1. 找到图像的最小值和最大值
-    for (int y = 0; y < result.height(); ++y) {
-        const uchar* line = result.constScanLine(y);
-        for (int x = 0; x < result.width(); ++x) {
-            int val = line[x];
-            if (val < minVal) minVal = val;
-            if (val > maxVal) maxVal = val;
-        }
+//归一化
+void SonogramGenerator::normalizeLut(int minVal, int maxVal, uchar lut[256])
+{
+    for (int i = 0; i < 256; ++i) {
+        const int val = qBound(minVal, i, maxVal);
+        lut[i] = static_cast<uchar>((val - minVal) * 255.0 / (maxVal - minVal));
     }
+}
 
-    if (maxVal == minVal) {
-        // 图像所有像素相同，返回原图
-        return result;
-    }
+QImage SonogramGenerator::applyNormalize(const QImage& src)
+{
+    return EnhancementPipeline().addNormalize().apply(src);
+}
 
-    // 2. 归一化
-    for (int y = 0; y < result.height(); ++y) {
-        uchar* line = result.scanLine(y);
-        for (int x = 0; x < result.width(); ++x) {
-            line[x] = static_cast<uchar>(
-                (line[x] - minVal) * 255.0 / (maxVal - minVal)
-                );
-        }
-    }
+TiledImage SonogramGenerator::applyNormalize(const TiledImage &src)
+{
+    return EnhancementPipeline().addNormalize().apply(src);
+}
 
-    return result;
+void SonogramGenerator::stretchLut(int minVal, int maxVal, uchar lut[256])
+{
+    for (int i = 0; i < 256; ++i) {
+        int stretched = (i - minVal) * 255 / (maxVal - minVal);
+        lut[i] = static_cast<uchar>(qBound(0, stretched, 255));
+    }
 }
 
 QImage SonogramGenerator::applyStretchIntensity(const QImage &src)
 {
-    if (src.isNull()) return src;
-
-    int width = src.width();
-    int height = src.height();
+    return EnhancementPipeline().addStretch().apply(src);
+}
 
-    int minVal = 255, maxVal = 0;
+TiledImage SonogramGenerator::applyStretchIntensity(const TiledImage &src)
+{
+    return EnhancementPipeline().addStretch().apply(src);
+}
 
-    // 找 min/max
-    for (int y = 0; y < height; ++y) {
-        const uchar *line = src.constScanLine(y);
-        for (int x = 0; x < width; ++x) {
-            int val = line[x];
-            if (val < minVal) minVal = val;
-            if (val > maxVal) maxVal = val;
-        }
+void SonogramGenerator::negativeLut(uchar lut[256])
+{
+    for (int i = 0; i < 256; ++i) {
+        lut[i] = static_cast<uchar>(255 - i);  // 灰度反转
     }
+}
 
-    if (maxVal == minVal) return src;
-
-    QImage dst(src.size(), QImage::Format_Grayscale8);
-
-    for (int y = 0; y < height; ++y) {
-        const uchar *srcLine = src.constScanLine(y);
-        uchar *dstLine = dst.scanLine(y);
-        for (int x = 0; x < width; ++x) {
-            int val = srcLine[x];
-            int stretched = (val - minVal) * 255 / (maxVal - minVal);
-            dstLine[x] = static_cast<uchar>(qBound(0, stretched, 255));
-        }
-    }
+QImage SonogramGenerator::applyNegative(const QImage &src)
+{
+    return EnhancementPipeline().addNegative().apply(src);
+}
 
-    return dst;
+TiledImage SonogramGenerator::applyNegative(const TiledImage &src)
+{
+    return EnhancementPipeline().addNegative().apply(src);
 }
 
-QImage SonogramGenerator::applyNegative(const QImage &src)
+QImage SonogramGenerator::applyClahe(const QImage &src, double clipLimit, int tilesAcross)
 {
-    if (src.isNull()) return src;
+    if (src.isNull()) return QImage();
 
-    QImage dst(src.size(), QImage::Format_Grayscale8);
+    QImage result = src.convertToFormat(QImage::Format_Grayscale8);
+    QVector<uchar*> rows(result.height());
+    uchar* bits = result.bits();
+    for (int y = 0; y < rows.size(); ++y) {
+        rows[y] = bits + static_cast<qint64>(y) * result.bytesPerLine();
+    }
+    claheInPlace(rows, result.width(), clipLimit, tilesAcross);
+    return result;
+}
 
-    for (int y = 0; y < src.height(); ++y) {
-        const uchar *srcLine = src.constScanLine(y);
-        uchar *dstLine = dst.scanLine(y);
-        for (int x = 0; x < src.width(); ++x) {
-            dstLine[x] = 255 - srcLine[x];  // 灰度反转
+TiledImage SonogramGenerator::applyClahe(const TiledImage &src, double clipLimit, int tilesAcross)
+{
+    if (src.isEmpty() || src.height() > INT_MAX) return src;
+
+    // 分块跨越条带边界，先拷贝出可写的条带，再按整幅图的行处理
+    QVector<QImage> tiles(src.tileCount());
+    QVector<uchar*> rows;
+    rows.reserve(static_cast<int>(src.height()));
+    for (int i = 0; i < tiles.size(); ++i) {
+        tiles[i] = src.tile(i).convertToFormat(QImage::Format_Grayscale8);
+        uchar* bits = tiles[i].bits();     // 和 src 共享时在这里分离
+        for (int y = 0; y < tiles[i].height(); ++y) {
+            rows.append(bits + static_cast<qint64>(y) * tiles[i].bytesPerLine());
         }
     }
+    claheInPlace(rows, src.width(), clipLimit, tilesAcross);
 
-    return dst;
-}
-
-QImage SonogramGenerator::applySlantRangeCorrection(const QVector<std::vector<uint8_t> > &portData, const QVector<std::vector<uint8_t> > &starboardData, const QVector<int> &portBottom, const QVector<int> &starboardBottom, double soundVelocity, double sampleInterval)
-{
-    // if (portData.isEmpty() || starboardData.isEmpty()) {
-    //     return QImage();
-    // }
-
-    // int numPings = qMin(portData.size(), starboardData.size());
-    // int numSamples = portData[0].size();
-
-    // // 单个采样点的单程距离分辨率 Δr
-    // double deltaR = soundVelocity * sampleInterval;
-
-    // // 计算最大斜距
-    // double maxR = numSamples * deltaR;
-    // int maxX = static_cast<int>(std::round(maxR));
-
-    // // 输出图像（宽=左右舷合并，高=numPings）
-    // QImage out(maxX * 2, numPings, QImage::Format_Grayscale8);
-    // out.fill(0);
-
-    // for (int i = 0; i < numPings; ++i) {
-    //     int bottomP = (i < portBottom.size()) ? portBottom[i] : numSamples / 2;
-    //     int bottomS = (i < starboardBottom.size()) ? starboardBottom[i] : numSamples / 2;
-
-    //     double depthP = bottomP * deltaR;
-    //     double depthS = bottomS * deltaR;
-
-    //     // 左舷
-    //     for (int j = bottomP; j < numSamples; ++j) {
-    //         double R = j * deltaR;
-    //         if (R < depthP) continue;
-    //         double x = qSqrt(R * R - depthP * depthP);
-    //         int xi = maxX - static_cast<int>(std::round(x)); // 左舷向左展开
-    //         if (xi >= 0 && xi < maxX) {
-    //             uint8_t val = 255 - portData[i][j]; // 颜色反转
-    //             out.setPixel(xi, i, qRgb(portData[i][j], portData[i][j], portData[i][j]));
-    //         }
-    //     }
-
-    //     // 右舷
-    //     for (int j = bottomS; j < numSamples; ++j) {
-    //         double R = j * deltaR;
-    //         if (R < depthS) continue;
-    //         double x = qSqrt(R * R - depthS * depthS);
-    //         int xi = maxX + static_cast<int>(std::round(x));
-    //         if (xi >= maxX && xi < 2 * maxX) {
-    //             uint8_t val = 255 - starboardData[i][j]; // 颜色反转
-    //             out.setPixel(xi, i, qRgb(starboardData[i][j], starboardData[i][j], starboardData[i][j]));
-    //         }
-    //     }
-    // }
-
-    // return out;
-
-    if (portData.isEmpty() || starboardData.isEmpty()) {
-        qDebug() << "No data loaded!";
-        return QImage();
-    }
-    if (portBottom.size() != portData.size() ||
-        starboardBottom.size() != starboardData.size()) {
-        qDebug() << "Bottom line size mismatch!";
-        return QImage();
+    TiledImage result;
+    for (const QImage& tile : tiles) {
+        result.append(tile);
     }
-    int numPings = portData.size();
-
-    int maxLeftWidth = portData[0].size();
-    int maxRightWidth = starboardData[0].size();
-    int totalWidth = maxLeftWidth + maxRightWidth;
-    int totalHeight = numPings;
-
-    QImage mergedImg(totalWidth, totalHeight, QImage::Format_RGB32);
-    mergedImg.fill(Qt::white);
-
-    // ---- 按 ping 处理 ----
-    for (int ping = 0; ping < numPings; ++ping) {
-        const auto& portRow = portData[ping];
-        const auto& starRow = starboardData[ping];
-
-        int startIdx = portBottom[ping];
-        int endIdx   = starboardBottom[ping];
-        if (startIdx < 0 || startIdx >= (int)portRow.size()) continue;
-        if (endIdx <= 0 || endIdx >= (int)starRow.size()) continue;
-
-        // 左舷有效区
-        int leftWidth = startIdx + 1;
-        QImage leftImg(leftWidth, 1, QImage::Format_RGB32);
-        for (int x = 0; x < leftWidth; ++x) {
-            int gray = 255 - portRow[x];
-            leftImg.setPixel(x, 0, qRgb(gray, gray, gray));
-        }
-        // leftImg = leftImg.scaled(maxLeftWidth, 1); // 拉伸到统一宽度   最近邻插值->快速但不平滑
-        leftImg = leftImg.scaled(maxLeftWidth, 1, Qt::IgnoreAspectRatio, Qt::SmoothTransformation); //平滑插值
-
-
-        // 右舷有效区
-        int rightWidth = starRow.size() - endIdx;
-        QImage rightImg(rightWidth, 1, QImage::Format_RGB32);
-        for (int x = 0; x < rightWidth; ++x) {
-            int gray = 255 - starRow[endIdx + x];
-            rightImg.setPixel(x, 0, qRgb(gray, gray, gray));
-        }
-        // rightImg = rightImg.scaled(maxRightWidth, 1); // 拉伸到统一宽度
-        rightImg = rightImg.scaled(maxRightWidth, 1, Qt::IgnoreAspectRatio, Qt::SmoothTransformation); //平滑插值
+    return result;
+}
 
-        // 拼接到 mergedImg
-        for (int x = 0; x < maxLeftWidth; ++x) {
-            int g = qGray(leftImg.pixel(x, 0));
-            mergedImg.setPixel(x, ping, qRgb(g, g, g));
-        }
-        for (int x = 0; x < maxRightWidth; ++x) {
-            int g = qGray(rightImg.pixel(x, 0));
-            mergedImg.setPixel(maxLeftWidth + x, ping, qRgb(g, g, g));
+void SonogramGenerator::claheInPlace(const QVector<uchar*> &rows, int width, double clipLimit, int tilesAcross)
+{
+    const int height = rows.size();
+    if (width <= 0 || height <= 0) return;
+
+    // 声图很长，块取正方形：宽度方向固定块数，高度方向按块宽切
+    const int tileW = qMax(1, (width + qMax(1, tilesAcross) - 1) / qMax(1, tilesAcross));
+    const int tileH = tileW;
+    const int gridX = (width + tileW - 1) / tileW;
+    const int gridY = (height + tileH - 1) / tileH;
+
+    // 每块一张 256 项映射表，按块行并行统计
+    QVector<uchar> luts(gridX * gridY * 256);
+    forEachBand(gridY, [&](int firstTileRow, int tileRowCount) {
+        QVector<qint64> hist(gridX * 256);
+        for (int ty = firstTileRow; ty < firstTileRow + tileRowCount; ++ty) {
+            hist.fill(0);
+            const int y0 = ty * tileH;
+            const int y1 = qMin(height, y0 + tileH);
+            for (int y = y0; y < y1; ++y) {
+                const uchar* line = rows[y];
+                for (int x = 0; x < width; ++x) {
+                    hist[(x / tileW) * 256 + line[x]]++;
+                }
+            }
+
+            for (int tx = 0; tx < gridX; ++tx) {
+                // 补白不参与统计，映射也只在数据灰度 [0, MaxDataGray] 内
+                const int levels = TiledImage::MaxDataGray + 1;
+                qint64* h = hist.data() + tx * 256;
+                uchar* lut = luts.data() + (ty * gridX + tx) * 256;
+                lut[TiledImage::PaddingGray] = TiledImage::PaddingGray;
+                qint64 area = 0;
+                for (int i = 0; i < levels; ++i) area += h[i];
+                if (area == 0) {    // 整块都是补白
+                    for (int i = 0; i < levels; ++i) lut[i] = static_cast<uchar>(i);
+                    continue;
+                }
+
+                // 截断超过限制的计数，多出的部分平均分回所有灰度
+                const qint64 limit = qMax<qint64>(1, static_cast<qint64>(clipLimit * area / levels));
+                qint64 excess = 0;
+                for (int i = 0; i < levels; ++i) {
+                    if (h[i] > limit) {
+                        excess += h[i] - limit;
+                        h[i] = limit;
+                    }
+                }
+                const qint64 share = excess / levels;
+                const qint64 remainder = excess % levels;
+                for (int i = 0; i < levels; ++i) {
+                    h[i] += share + (i < remainder ? 1 : 0);
+                }
+
+                qint64 cdf = 0;
+                for (int i = 0; i < levels; ++i) {
+                    cdf += h[i];
+                    lut[i] = static_cast<uchar>(qMin<qint64>(TiledImage::MaxDataGray,
+                                                             (cdf * TiledImage::MaxDataGray + area / 2) / area));
+                }
+            }
         }
+    });
+
+    // 每列两侧块的序号和右侧块的权重（0..256），以块中心为插值节点
+    QVector<int> leftTile(width), rightTile(width), rightWeight(width);
+    for (int x = 0; x < width; ++x) {
+        const double gx = (x + 0.5) / tileW - 0.5;
+        const int left = static_cast<int>(std::floor(gx));
+        rightWeight[x] = qBound(0, static_cast<int>((gx - left) * 256 + 0.5), 256);
+        leftTile[x] = qBound(0, left, gridX - 1);
+        rightTile[x] = qBound(0, left + 1, gridX - 1);
     }
 
-    return mergedImg;
-
+    forEachBand(height, [&](int firstRow, int rowCount) {
+        for (int y = firstRow; y < firstRow + rowCount; ++y) {
+            const double gy = (y + 0.5) / tileH - 0.5;
+            const int top = static_cast<int>(std::floor(gy));
+            const int wy = qBound(0, static_cast<int>((gy - top) * 256 + 0.5), 256);
+            const uchar* topLuts = luts.constData() + qBound(0, top, gridY - 1) * gridX * 256;
+            const uchar* bottomLuts = luts.constData() + qBound(0, top + 1, gridY - 1) * gridX * 256;
+
+            uchar* line = rows[y];
+            for (int x = 0; x < width; ++x) {
+                const int v = line[x];
+                if (v == TiledImage::PaddingGray) continue;
+                const int wx = rightWeight[x];
+                const int l = leftTile[x] * 256 + v;
+                const int r = rightTile[x] * 256 + v;
+                const int upper = topLuts[l] * (256 - wx) + topLuts[r] * wx;
+                const int lower = bottomLuts[l] * (256 - wx) + bottomLuts[r] * wx;
+                line[x] = static_cast<uchar>((upper * (256 - wy) + lower * wy + (1 << 15)) >> 16);
+            }
+        }
+    });
 }
 
@@ -4,40 +4,89 @@
 #include <QImage>
 #include <QVector>
 #include <vector>
+#include <functional>
 #include <cstdint>
+#include "pingmatrix.h"
+#include "pingmeta.h"
+#include "tiledimage.h"
 
 class SonogramGenerator
 {
 public:
     SonogramGenerator();
 
-    // 输入左、右舷数据，生成声呐图像
-    QImage createSonogram(const QVector<std::vector<uint8_t>>& portData,
-                          const QVector<std::vector<uint8_t>>& starboardData,
-                          bool combine = true);
+    // 左右舷拼图的布局：每舷各占 sideWidth 列（两舷最长行中较大者），左舷在 [0, sideWidth)，
+    // 右舷从 sideWidth 列开始。底图、瀑布图、CLAHE 和斜距矫正图都按这个布局，切换时图像不左右移动
+    static int sideWidth(const PingMatrix* portData, const PingMatrix* starboardData);
+
+    // 整条测线的声呐图，按条带切分，不受 QImage 大小限制
+    TiledImage createTiledSonogram(const PingMatrix& portData,
+                                   const PingMatrix& starboardData);
+
+    // 以下增强接口都有 QImage 和 TiledImage 两个版本，都是单个操作的 EnhancementPipeline，
+    // 统计和查表按行分块在全局线程池上并行；
+    // 连续多个增强时直接用 EnhancementPipeline，只统计、处理一遍像素
 
     // 灰度/伽马矫正接口
     static QImage applyGamma(const QImage& src, double gamma);
+    static TiledImage applyGamma(const TiledImage& src, double gamma);
 
     // 直方图均衡化接口
     static QImage applyHistogramEqualization(const QImage& src);
+    static TiledImage applyHistogramEqualization(const TiledImage& src);
 
     //归一化接口
     static QImage applyNormalize(const QImage& src);
+    static TiledImage applyNormalize(const TiledImage& src);
 
     // 强度拉伸（Stretch Intensity）
     static QImage applyStretchIntensity(const QImage& src);
+    static TiledImage applyStretchIntensity(const TiledImage& src);
 
     // 负片效果 (Negative)
     static QImage applyNegative(const QImage& src);
+    static TiledImage applyNegative(const TiledImage& src);
+
+    // 限制对比度自适应直方图均衡化（CLAHE）：横向分 tilesAcross 块、块高等于块宽，
+    // 各块直方图按 clipLimit 倍平均值截断后求映射，像素在相邻四块的映射之间双线性插值。
+    // 补白不参与统计、保持不变。不是逐点操作，不能放进 EnhancementPipeline
+    static QImage applyClahe(const QImage& src, double clipLimit = 2.0, int tilesAcross = 8);
+    static TiledImage applyClahe(const TiledImage& src, double clipLimit = 2.0, int tilesAcross = 8);
 
+    // 灰度直方图，按行块并行统计后合并；图像的补白（TiledImage::PaddingGray）不计入
+    static void accumulateHistogram(const QImage& gray, qint64 hist[256]);
+    static void accumulateHistogram(const TiledImage& gray, qint64 hist[256]);
+    // 直接按 ping 矩阵统计显示用的反色灰度，不生成声图；短行补白的部分不计入
+    static void accumulateHistogram(const PingMatrix& data, qint64 hist[256]);
+    // 直方图中的最小/最大灰度，空图或所有像素相同时返回 false
+    static bool histogramRange(const qint64 hist[256], int& minVal, int& maxVal);
 
-    // 斜距矫正并拼接左右舷
-    static QImage applySlantRangeCorrection(const QVector<std::vector<uint8_t>> &portData, const QVector<std::vector<uint8_t>> &starboardData,const QVector<int> &portBottom,const QVector<int> &starboardBottom, double soundVelocity, double sampleInterval);
+    // 灰度查找表：增强只更新 256 项查找表，显示时查表，不处理像素
+    static void identityLut(uchar lut[256]);
+    static void gammaLut(double gamma, uchar lut[256]);
+    static void equalizationLut(const qint64 hist[256], uchar lut[256]);
+    static void normalizeLut(int minVal, int maxVal, uchar lut[256]);
+    static void stretchLut(int minVal, int maxVal, uchar lut[256]);
+    static void negativeLut(uchar lut[256]);
+
+    // 按查找表一遍处理像素，结果为 Grayscale8；补白保持不变，数据像素不会变成补白
+    static QImage applyLut(const QImage& src, const uchar lut[256]);
+    static TiledImage applyLut(const TiledImage& src, const uchar lut[256]);
+
+    // 第 ping 行反色写入 dst（不超过 MaxDataGray），不足 width 的部分补白（ping 超出行数时整行补白）
+    static void writeInvertedRow(const PingMatrix& data, int ping, uchar* dst, int width);
 
 
 private:
-    QImage vectorToImage(const QVector<std::vector<uint8_t>>& data);
+    // 左右舷第 firstRow 起 rowCount 行一次拼成一张图
+    QImage combineRows(const PingMatrix& portData, const PingMatrix& starboardData, int firstRow, int rowCount);
+    // 反色拷贝：SSE2/AVX2 按 16/32 字节一组处理
+    static void invertRow(const uint8_t* src, uchar* dst, int count);
+
+    // 把 [0, rows) 切成若干行块在全局线程池上并行执行 op(first, count)，行数少时直接在当前线程执行
+    static void forEachBand(int rows, const std::function<void(int, int)>& op);
+    // 对按行给出的灰度图原地做 CLAHE，行可以来自不同的条带
+    static void claheInPlace(const QVector<uchar*>& rows, int width, double clipLimit, int tilesAcross);
 };
 
 #endif // SONOGRAMGENERATOR_H
@@ -0,0 +1,50 @@
+#include "tiledimage.h"
+#include <algorithm>
+
+TiledImage::TiledImage()
+{
+}
+
+int TiledImage::rowsPerTileFor(qint64 bytesPerLine)
+{
+    return static_cast<int>(qMax<qint64>(1, TileBytes / qMax<qint64>(1, bytesPerLine)));
+}
+
+void TiledImage::clear()
+{
+    tiles.clear();
+    tops.clear();
+    imageWidth = 0;
+    rows = 0;
+}
+
+void TiledImage::append(const QImage &strip)
+{
+    if (strip.isNull()) return;
+
+    const int tileRows = rowsPerTileFor(strip.bytesPerLine());
+    for (int y = 0; y < strip.height(); y += tileRows) {
+        const int n = qMin(tileRows, strip.height() - y);
+        tiles.append(n == strip.height() ? strip : strip.copy(0, y, strip.width(), n));
+        tops.append(rows);
+        rows += n;
+    }
+    imageWidth = qMax(imageWidth, strip.width());
+}
+
+int TiledImage::tileAt(qint64 row) const
+{
+    if (row < 0 || row >= rows) return -1;
+    // tops 递增，找最后一个 <= row 的条带
+    auto it = std::upper_bound(tops.constBegin(), tops.constEnd(), row);
+    return static_cast<int>(it - tops.constBegin()) - 1;
+}
+
+TiledImage TiledImage::mapped(const std::function<QImage(const QImage&)>& op) const
+{
+    TiledImage result;
+    for (const QImage& t : tiles) {
+        result.append(op(t));
+    }
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef TILEDIMAGE_H
+#define TILEDIMAGE_H
+
+#include <QImage>
+#include <QVector>
+#include <functional>
+
+// 按行切成若干条带的大图：每个条带是一张普通 QImage（不超过 TileBytes），
+// 整体行数用 qint64 记录，长测线不再受单张 QImage 2^31 字节的限制
+class TiledImage
+{
+public:
+    static const qint64 TileBytes = 64 * 1024 * 1024;
+    // 声图中没有数据的补白固定为 PaddingGray（白），有数据的像素不超过 MaxDataGray；
+    // 增强、CLAHE 和显示都跳过补白，换查找表时补白始终是白色
+    static constexpr uchar PaddingGray = 255;
+    static constexpr uchar MaxDataGray = 254;
+
+    TiledImage();
+
+    // 每行 bytesPerLine 字节时一个条带的行数
+    static int rowsPerTileFor(qint64 bytesPerLine);
+
+    void clear();
+    // 追加一个条带，超过 TileBytes 时按行再切开
+    void append(const QImage& strip);
+
+    bool isEmpty() const { return tiles.isEmpty(); }
+    int width() const { return imageWidth; }
+    qint64 height() const { return rows; }
+
+    int tileCount() const { return tiles.size(); }
+    const QImage& tile(int i) const { return tiles[i]; }
+    qint64 tileTop(int i) const { return tops[i]; }
+    // 包含第 row 行的条带，超出范围返回 -1
+    int tileAt(qint64 row) const;
+
+    // 对每个条带做同样的处理（只适用于逐像素操作），条带之间互不影响
+    TiledImage mapped(const std::function<QImage(const QImage&)>& op) const;
+
+private:
+    QVector<QImage> tiles;
+    QVector<qint64> tops;       // 每个条带首行的行号
+    int imageWidth = 0;
+    qint64 rows = 0;
+};
+
+#endif // TILEDIMAGE_H
@@ -0,0 +1,347 @@
+#include "waterfallview.h"
+#include "sonogramgenerator.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <QScrollBar>
+#include <QThreadPool>
+#include <QWheelEvent>
+#include <QtConcurrent>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+WaterfallView::WaterfallView(QWidget *parent)
+    : QAbstractScrollArea(parent)
+{
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setLut(nullptr);
+    // 金字塔的块在后台生成，生成后重画（跨线程时排队到界面线程）
+    connect(&pyramid, &ImagePyramid::tilesReady, viewport(), [this]() { viewport()->update(); });
+}
+
+void WaterfallView::setPingData(const PingMatrix *port, const PingMatrix *starboard)
+{
+    dataset.reset();
+    pyramid.setImage(TiledImage());
+    imageSource = false;
+    portData = port;
+    starboardData = starboard;
+    updateScrollRange();
+    viewport()->update();
+}
+
+void WaterfallView::pingsAppended()
+{
+    QScrollBar* bar = verticalScrollBar();
+    const bool atEnd = bar->maximum() > 0 && bar->value() == bar->maximum();
+    updateScrollRange();
+    if (atEnd) bar->setValue(bar->maximum());
+    viewport()->update();
+}
+
+void WaterfallView::setDataset(const SonarDatasetPtr &data)
+{
+    // 跟随写入时换成更长的新数据集：原来停在末尾就继续停在末尾
+    QScrollBar* bar = verticalScrollBar();
+    const bool atEnd = bar->maximum() > 0 && bar->value() == bar->maximum();
+    setPingData(data ? &data->port() : nullptr, data ? &data->starboard() : nullptr);
+    dataset = data;
+    if (atEnd) bar->setValue(bar->maximum());
+}
+
+void WaterfallView::setImage(const TiledImage &image)
+{
+    dataset.reset();
+    portData = nullptr;
+    starboardData = nullptr;
+    imageSource = true;
+    pyramid.setImage(image);
+    updateScrollRange();
+    viewport()->update();
+}
+
+void WaterfallView::clear()
+{
+    setPingData(nullptr, nullptr);
+    overlays.clear();
+}
+
+void WaterfallView::setLut(const uchar *table)
+{
+    if (table) std::copy(table, table + 256, lut);
+    else SonogramGenerator::identityLut(lut);
+    viewport()->update();
+}
+
+void WaterfallView::setOverlays(const QVector<WaterfallOverlay> &lines)
+{
+    overlays = lines;
+    viewport()->update();
+}
+
+int WaterfallView::imageWidth() const
+{
+    if (imageSource) return pyramid.image().width();
+    return 2 * SonogramGenerator::sideWidth(portData, starboardData);
+}
+
+int WaterfallView::imageRows() const
+{
+    if (imageSource) return static_cast<int>(qMin<qint64>(pyramid.image().height(), INT_MAX));
+    return qMax(portData ? portData->rows() : 0, starboardData ? starboardData->rows() : 0);
+}
+
+qreal WaterfallView::scale() const
+{
+    const int width = imageWidth();
+    return width > 0 ? zoomFactor * viewport()->width() / width : zoomFactor;
+}
+
+void WaterfallView::updateScrollRange()
+{
+    const qreal s = scale();
+    const int rows = imageRows();
+    const int visibleRows = qMax(1, static_cast<int>(viewport()->height() / s));
+    verticalScrollBar()->setRange(0, qMax(0, rows - visibleRows));
+    verticalScrollBar()->setPageStep(visibleRows);
+    verticalScrollBar()->setSingleStep(qMax(1, visibleRows / 20));
+
+    // 横向按屏幕像素滚动，适配宽度时没有可滚动的范围
+    const int screenWidth = viewport()->width();
+    const int contentWidth = static_cast<int>(std::ceil(imageWidth() * s));
+    horizontalScrollBar()->setRange(0, qMax(0, contentWidth - screenWidth));
+    horizontalScrollBar()->setPageStep(screenWidth);
+    horizontalScrollBar()->setSingleStep(qMax(1, screenWidth / 20));
+}
+
+void WaterfallView::setZoom(qreal factor, const QPoint &anchor)
+{
+    factor = qBound<qreal>(1.0, factor, MaxZoom);
+    if (qFuzzyCompare(factor, zoomFactor)) return;
+
+    // 缩放前后 anchor 下的图像位置不变
+    const qreal oldScale = scale();
+    const qreal column = (horizontalScrollBar()->value() + anchor.x()) / oldScale;
+    const qreal row = verticalScrollBar()->value() + anchor.y() / oldScale;
+    zoomFactor = factor;
+    const qreal newScale = scale();
+    updateScrollRange();
+    horizontalScrollBar()->setValue(qRound(column * newScale - anchor.x()));
+    verticalScrollBar()->setValue(qRound(row - anchor.y() / newScale));
+    viewport()->update();
+}
+
+void WaterfallView::wheelEvent(QWheelEvent *event)
+{
+    // Ctrl + 滚轮缩放，每格 1.25 倍；其余照常滚动
+    if (!(event->modifiers() & Qt::ControlModifier)) {
+        QAbstractScrollArea::wheelEvent(event);
+        return;
+    }
+    const int delta = event->angleDelta().y();
+    if (delta != 0) setZoom(zoomFactor * std::pow(1.25, delta / 120.0), event->pos());
+    event->accept();
+}
+
+void WaterfallView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollRange();
+}
+
+void WaterfallView::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+    viewport()->update();
+}
+
+void WaterfallView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(viewport());
+    painter.fillRect(viewport()->rect(), Qt::white);
+
+    const int rows = imageRows();
+    if (imageWidth() <= 0 || rows <= 0) return;
+
+    const qreal s = scale();
+    const int first = qBound(0, verticalScrollBar()->value(), rows - 1);
+    const int left = horizontalScrollBar()->value();
+    const int screenWidth = qMin(viewport()->width(), static_cast<int>(std::ceil(imageWidth() * s)) - left);
+    const int screenRows = qMin(viewport()->height(), static_cast<int>(std::ceil((rows - first) * s)));
+    if (screenWidth <= 0 || screenRows <= 0) return;
+
+    painter.drawImage(0, 0, renderRows(first, left, screenWidth, screenRows, s));
+    drawOverlays(painter, first, left, screenRows, s);
+}
+
+QImage WaterfallView::renderRows(int first, int left, int screenWidth, int screenRows, qreal s)
+{
+    const int width = imageWidth();
+    const int rows = imageRows();
+
+    // 图像源缩小显示时换到金字塔中对应的层，每行要扫描的像素与屏幕宽度相当；
+    // 该层的块还没生成时这一行先按原图取像素，块在后台生成完再重画
+    const int level = imageSource ? pyramid.levelForScale(s) : 0;
+    const int levelWidth = level > 0 ? pyramid.levelWidth(level) : width;
+
+    // 第 x 列屏幕像素覆盖 [spans[x], spans[x + 1]) 列样本，至少一列
+    auto columnSpans = [&](int lvl, int limit) {
+        std::vector<int> result(static_cast<size_t>(screenWidth) + 1);
+        for (int x = 0; x <= screenWidth; ++x) {
+            result[x] = qMin(limit, static_cast<int>((left + x) / s) >> lvl);
+        }
+        return result;
+    };
+    const std::vector<int> spans = columnSpans(level, levelWidth);
+    const std::vector<int> baseSpans = level > 0 ? columnSpans(0, width) : spans;
+
+    // 每个屏幕行取最近的 ping 行；图像源的条带和金字塔的块都在这里取好
+    const int tilesAcross = (levelWidth + ImagePyramid::TileSize - 1) / ImagePyramid::TileSize;
+    // 放大后只取横向可见的块
+    const int firstTile = spans.front() / ImagePyramid::TileSize;
+    const int endTile = qMin(tilesAcross, spans.back() / ImagePyramid::TileSize + 1);
+    std::vector<int> sourceRows(static_cast<size_t>(screenRows));
+    std::vector<const uchar*> baseLines(imageSource ? screenRows : 0);
+    std::vector<int> baseWidths(imageSource ? screenRows : 0);   // 条带可能比整幅图窄
+    std::vector<const uchar*> tileLines(level > 0 ? static_cast<size_t>(screenRows) * tilesAcross : 0);
+    std::vector<char> tileRowReady(level > 0 ? screenRows : 0, 0);
+    QHash<int, QVector<QImage>> heldTiles;     // 绘制期间持有用到的块
+    for (int y = 0; y < screenRows; ++y) {
+        const int row = qMin(rows - 1, first + static_cast<int>(y / s));
+        sourceRows[y] = row;
+        if (!imageSource) continue;
+
+        const TiledImage& image = pyramid.image();
+        const int strip = image.tileAt(row);
+        baseLines[y] = image.tile(strip).constScanLine(static_cast<int>(row - image.tileTop(strip)));
+        baseWidths[y] = image.tile(strip).width();
+        if (level == 0) continue;
+
+        const int levelRow = row >> level;
+        const int ty = levelRow / ImagePyramid::TileSize;
+        if (!heldTiles.contains(ty)) {
+            QVector<QImage> tiles(tilesAcross);
+            for (int tx = firstTile; tx < endTile; ++tx) tiles[tx] = pyramid.tile(level, tx, ty);
+            heldTiles.insert(ty, tiles);
+        }
+        const QVector<QImage>& held = heldTiles[ty];
+        bool ready = true;
+        for (int tx = firstTile; tx < endTile && ready; ++tx) {
+            const QImage& t = held[tx];
+            ready = !t.isNull();
+            if (ready) tileLines[static_cast<size_t>(y) * tilesAcross + tx] = t.constScanLine(qMin(levelRow % ImagePyramid::TileSize, t.height() - 1));
+        }
+        tileRowReady[y] = ready;
+    }
+
+    QImage frame(screenWidth, screenRows, QImage::Format_Grayscale8);
+    const int side = SonogramGenerator::sideWidth(portData, starboardData);
+    auto renderBand = [&](int begin, int end) {
+        std::vector<uchar> line(static_cast<size_t>(imageSource ? levelWidth : width));
+        for (int y = begin; y < end; ++y) {
+            const uchar* src = line.data();
+            const int* span = spans.data();
+            int available = width;
+            if (imageSource && level > 0 && tileRowReady[y]) {
+                // 把这一行跨过的各块拼起来
+                for (int tx = firstTile; tx < endTile; ++tx) {
+                    const int x0 = tx * ImagePyramid::TileSize;
+                    std::memcpy(line.data() + x0, tileLines[static_cast<size_t>(y) * tilesAcross + tx],
+                                qMin(ImagePyramid::TileSize, levelWidth - x0));
+                }
+                available = levelWidth;
+            } else if (imageSource) {
+                src = baseLines[y];
+                span = baseSpans.data();
+                available = baseWidths[y];
+            } else {
+                // 与底图布局相同：两舷各占 side 列，反色，短行补白
+                if (portData) SonogramGenerator::writeInvertedRow(*portData, sourceRows[y], line.data(), side);
+                else std::memset(line.data(), TiledImage::PaddingGray, side);
+                if (starboardData) SonogramGenerator::writeInvertedRow(*starboardData, sourceRows[y], line.data() + side, side);
+                else std::memset(line.data() + side, TiledImage::PaddingGray, side);
+            }
+            uchar* out = frame.scanLine(y);
+            for (int x = 0; x < screenWidth; ++x) {
+                const int b = span[x];
+                if (b >= available) {
+                    out[x] = TiledImage::PaddingGray;
+                    continue;
+                }
+                // 反色灰度越小回波越强，取最小值保留亮目标；只有补白时画白色，不套查找表
+                const int e = qMin(available, qMax(b + 1, span[x + 1]));
+                uchar darkest = src[b];
+                for (int c = b + 1; c < e; ++c) darkest = qMin(darkest, src[c]);
+                out[x] = darkest == TiledImage::PaddingGray ? TiledImage::PaddingGray : lut[darkest];
+            }
+        }
+    };
+
+    // 按行块并行，与其他逐像素处理相同
+    const int chunkCount = QThreadPool::globalInstance()->maxThreadCount() * 4;
+    const int chunkSize = qMax(16, (screenRows + chunkCount - 1) / chunkCount);
+    if (chunkSize >= screenRows) {
+        renderBand(0, screenRows);
+        return frame;
+    }
+    QVector<QPair<int, int>> bands;
+    for (int begin = 0; begin < screenRows; begin += chunkSize) {
+        bands.append(qMakePair(begin, qMin(screenRows, begin + chunkSize)));
+    }
+    QtConcurrent::blockingMap(bands, [&renderBand](const QPair<int, int>& band) {
+        renderBand(band.first, band.second);
+    });
+    return frame;
+}
+
+void WaterfallView::drawOverlays(QPainter &painter, int first, int left, int screenRows, qreal s) const
+{
+    if (overlays.isEmpty()) return;
+
+    // 只取可见的 ping；落在同一屏幕行的 ping 只保留最小列和最大列两个点（按出现顺序），
+    // 顶点数不超过屏幕行数的两倍，与缩放比例和测线长度无关
+    const int last = qMin(imageRows(), first + static_cast<int>(std::ceil(screenRows / s)) + 1);
+    painter.setRenderHint(QPainter::Antialiasing);
+    for (const WaterfallOverlay& overlay : overlays) {
+        QPainterPath path;
+        bool open = false;
+        auto addPoint = [&](int ping, int column) {
+            // 点放在像素中心
+            const QPointF point((overlay.offset + column + 0.5) * s - left, (ping - first + 0.5) * s);
+            if (open) {
+                path.lineTo(point);
+            } else {
+                path.moveTo(point);
+                open = true;
+            }
+        };
+
+        const int end = qMin(last, overlay.columns.size());
+        for (int ping = first; ping < end;) {
+            const int screenRow = static_cast<int>((ping - first) * s);
+            int minPing = -1, maxPing = -1;
+            int next = ping;
+            for (; next < end && static_cast<int>((next - first) * s) == screenRow; ++next) {
+                const int column = overlay.columns[next];
+                if (column < 0) continue;
+                if (minPing < 0 || column < overlay.columns[minPing]) minPing = next;
+                if (maxPing < 0 || column > overlay.columns[maxPing]) maxPing = next;
+            }
+            ping = next;
+
+            if (minPing < 0) {      // 整行都没有点，折线断开
+                open = false;
+                continue;
+            }
+            const int firstPing = qMin(minPing, maxPing);
+            const int secondPing = qMax(minPing, maxPing);
+            addPoint(firstPing, overlay.columns[firstPing]);
+            if (secondPing != firstPing) addPoint(secondPing, overlay.columns[secondPing]);
+        }
+        painter.strokePath(path, overlay.pen);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef WATERFALLVIEW_H
+#define WATERFALLVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QPen>
+#include <QVector>
+#include "pingmatrix.h"
+#include "sonardataset.h"
+#include "tiledimage.h"
+#include "imagepyramid.h"
+
+// 叠加在瀑布图上的折线：columns[ping] 为该 ping 的列号（< 0 表示没有点），画在 offset + 列号处
+struct WaterfallOverlay {
+    QVector<int> columns;
+    int offset = 0;
+    QPen pen;
+};
+
+// 瀑布图，默认按宽度适配，Ctrl + 滚轮以光标为中心放大（最多 MaxZoom 倍），放大后可横向滚动。
+// 每次重绘只取视口内可见的 ping 行和列，每个屏幕像素取所覆盖样本中回波最强的一个，
+// 灰度查找表在绘制时套用。数据源可以是左右舷 ping 矩阵（与底图一样左舷在左、反色显示），也可以是 TiledImage。
+// 不保存整幅图的像素，内存与文件大小无关；调整增强只重画可见像素
+class WaterfallView : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    static constexpr qreal MaxZoom = 32.0;
+
+    explicit WaterfallView(QWidget* parent = nullptr);
+
+    // 直接显示 ping 矩阵，矩阵由调用者持有；读取过程中追加了 ping 之后调用 pingsAppended()，
+    // 原来已滚动到底（且可以滚动）时保持显示最新的 ping
+    void setPingData(const PingMatrix* port, const PingMatrix* starboard);
+    void pingsAppended();
+    // 显示数据集的左右舷，视图同时持有数据集；换成同一测线更长的数据集时同样保持停在末尾
+    void setDataset(const SonarDatasetPtr& data);
+    // 显示处理过的图像（CLAHE、斜距矫正等），缩小时按 ImagePyramid 的层取像素
+    void setImage(const TiledImage& image);
+    void clear();
+
+    // 256 项灰度查找表，nullptr 表示按原灰度显示
+    void setLut(const uchar* table);
+
+    // 叠加折线，绘制时只取可见 ping，并按屏幕行抽稀为每行最多两个点
+    void setOverlays(const QVector<WaterfallOverlay>& lines);
+
+    int imageWidth() const;
+    int imageRows() const;
+
+    // 相对宽度适配的放大倍数（1 为适配宽度），anchor 为视口内保持不动的点
+    qreal zoom() const { return zoomFactor; }
+    void setZoom(qreal factor, const QPoint& anchor = QPoint());
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void wheelEvent(QWheelEvent* event) override;
+
+private:
+    // 屏幕像素 / 图像像素：适配宽度的比例乘以放大倍数
+    qreal scale() const;
+    void updateScrollRange();
+    // 画出 [first, first + screenRows / scale) 行，left 为横向滚动的屏幕像素，返回 screenWidth × screenRows 的灰度图
+    QImage renderRows(int first, int left, int screenWidth, int screenRows, qreal s);
+    void drawOverlays(QPainter& painter, int first, int left, int screenRows, qreal s) const;
+
+    const PingMatrix* portData = nullptr;
+    const PingMatrix* starboardData = nullptr;
+    SonarDatasetPtr dataset;
+    bool imageSource = false;   // true 时数据源为 pyramid.image()
+    ImagePyramid pyramid;
+
+    uchar lut[256];
+    QVector<WaterfallOverlay> overlays;
+    qreal zoomFactor = 1.0;
+};
+
+#endif // WATERFALLVIEW_H
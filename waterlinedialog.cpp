@@ -1,9 +1,7 @@
 #include "waterlinedialog.h"
 #include "ui_waterlinedialog.h"
 #include "sonogramgenerator.h"   // 用到 gamma 矫正
-#include <QGraphicsScene>
-#include <QGraphicsPixmapItem>
-#include <QShowEvent>
+#include "waterfallview.h"
 #include <QDebug>
 
 WaterlineDialog::WaterlineDialog(QWidget *parent)
@@ -12,15 +10,14 @@ WaterlineDialog::WaterlineDialog(QWidget *parent)
 {
     ui->setupUi(this);
 
-    scene = new QGraphicsScene(this);
-
-    ui->graphicsView->setScene(scene);
-
     // 默认 gamma=1.0
     ui->horizontalSlider->setRange(10, 300); // 0.1 - 3.0
     ui->horizontalSlider->setValue(100);
 
     ui->portRadio->setChecked(true);   // 默认左舷
+
+    // 默认仍用阈值搜索，高度引导由用户勾选
+    ui->altitudeSeededCheckBox->setChecked(tracker.mode() == BottomTracker::AltitudeSeeded);
 }
 
 WaterlineDialog::~WaterlineDialog()
@@ -29,12 +26,12 @@ WaterlineDialog::~WaterlineDialog()
 }
 
 
-void WaterlineDialog::setData(const QVector<std::vector<uint8_t> > &port, const QVector<std::vector<uint8_t> > &starboard, const QImage &img)
+void WaterlineDialog::setData(const SonarDatasetPtr &data)
 {
-    portDataAll = port;
-    starboardDataAll = starboard;
-    originalImage = img;
-    currentImage = img;
+    dataset = data;
+    claheImage = TiledImage();
+    claheShown = false;
+    histogramReady = false;
 
     updateView();
     doBottomTrack();
@@ -43,262 +40,79 @@ void WaterlineDialog::setData(const QVector<std::vector<uint8_t> > &port, const
 
 void WaterlineDialog::updateView()
 {
-    fitToWidth(ui->graphicsView, currentImage);
+    // 原始数据直接按 ping 矩阵绘制，不生成整幅声图
+    if (claheShown) ui->waterfallView->setImage(claheImage);
+    else ui->waterfallView->setDataset(dataset);
 }
 
-void WaterlineDialog::fitToWidth(QGraphicsView *view, const QImage &image)
+void WaterlineDialog::showClahe(bool show)
 {
-    if (image.isNull()) return;
-
-    if (!imageItem) {
-        imageItem = scene->addPixmap(QPixmap::fromImage(image));
-    } else {
-        imageItem->setPixmap(QPixmap::fromImage(image));
-    }
-
-    qreal viewWidth = view->viewport()->width();
-    qreal imgWidth  = image.width();
-    if (imgWidth > 0) {
-        qreal scaleFactor = viewWidth / imgWidth;
-        QTransform transform;
-        transform.scale(scaleFactor, scaleFactor);
-        view->setTransform(transform);
-    }
-
-    view->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    view->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    if (show == claheShown) return;
 
-    scene->setSceneRect(imageItem->boundingRect());
+    claheShown = show;
+    updateView();
 }
 
-void WaterlineDialog::showEvent(QShowEvent *event)
+void WaterlineDialog::updateColorTable()
 {
-    QDialog::showEvent(event);   // 调用父类实现，保持默认行为
-    updateView();                // 确保用正确的 viewport 宽度重新适配
+    // 原始数据的直方图只统计一次（直接按 ping 矩阵），之后的均衡化/归一化都是 256 项的计算
+    if (!histogramReady && pipeline.needsHistogram()) {
+        std::fill(imageHistogram, imageHistogram + 256, 0);
+        if (dataset) {
+            SonogramGenerator::accumulateHistogram(dataset->port(), imageHistogram);
+            SonogramGenerator::accumulateHistogram(dataset->starboard(), imageHistogram);
+        }
+        histogramReady = true;
+    }
+
+    uchar lut[256];
+    pipeline.buildLut(imageHistogram, lut);
+    ui->waterfallView->setLut(lut);
 }
 
 void WaterlineDialog::doBottomTrack()
 {
-    if (portDataAll.isEmpty() || starboardDataAll.isEmpty())
+    if (!dataset || dataset->port().isEmpty() || dataset->starboard().isEmpty())
         return;
 
-    // 删除之前的水线（避免重复绘制）
-    for (auto item : bottomLineItems) {
-        scene->removeItem(item);
-        delete item;
-    }
-    bottomLineItems.clear();
-
-    //记录上一ping有点采样点位置
-    int prePortPing = -1;
-    // int preStarboardPing = -1;
-    int maxJump = 150;
-
-    // ---- 左舷 ----
-    for (int ping = 0 ; ping < portDataAll.size(); ++ping) {
-        const std::vector<uint8_t>& samples = portDataAll[ping];
-        int idx = -1;
-        int CustomStartIdx = static_cast<int>(samples.size() * 0.7);
-        int PortPingPos = findAppropriateStartIdx(samples, CustomStartIdx);
-
-        for (int i = PortPingPos; i < (int)samples.size(); ++i) {
-            if (samples[i] == 0) {
-                int ZeroCount = 0;
-                int checkRange = std::min(50, (int)samples.size() - i);
-                for (int k = 0; k < checkRange; ++k) {
-                    if (samples[i + k] < 1) ZeroCount++;
-                }
-                if (ZeroCount > checkRange*0.9) {
-                    idx = i;
-                    break;
-                }
-            }
-        }
-
-        if (ping == 0) {
-            if (idx == -1) idx = CustomStartIdx;
-            int bestmean = INT_MAX;
-            for (int i = idx; i < (int)samples.size(); ++i) {
-                if (samples[i] <= 3) {
-                    int localsum = 0;
-                    int localcount = 0;
-                    int window = 100;
-                    for (int k = 0; k < window; ++k) {
-                        int Pos = i + k;
-                        if (Pos < (int)samples.size()) {
-                            localsum += samples[Pos];
-                            localcount++;
-                        } else break;
-                    }
-                    int localmean = localsum / std::max(1, localcount);
-
-                    if (localmean <= 5 && localmean > 0) {
-                        if (localmean <= bestmean) {
-                            bestmean = localmean;
-                            idx = i;
-                        }
-                    }
-                }
-            }
-        } else {
-            if (abs(idx - prePortPing) > maxJump || idx == -1) {
-                int candidate = -1;
-                int minPos = std::min(idx, prePortPing);
-                minPos = minPos >= PortPingPos ? PortPingPos : minPos;
-                int maxPos = std::max(idx, prePortPing);
-                int bestMean = INT_MAX;
-
-                for (int i = minPos; i <= maxPos; ++i) {
-                    if (samples[i] <= 3) {
-                        int localSum = 0;
-                        int localCount = 0;
-                        int win = 120;
-                        for (int k = 0; k < win; ++k) {
-                            int pos = i + k;
-                            if (pos < (int)samples.size()) {
-                                localSum += samples[pos];
-                                localCount++;
-                            }
-                        }
-                        int localMean = localSum / std::max(1, localCount);
-                        if (localMean <= 5) {
-                            if (localMean <= bestMean) {
-                                bestMean = localMean;
-                                candidate = i;
-                            }
-                        }
-                    }
-                }
-                if (candidate != -1) idx = candidate;
-            }
-        }
-        if (idx < 0) idx = samples.size() - 1;
-        portBottomLine.append(idx);
-        prePortPing = idx;
-    }
-
-    // ---- 右舷 ----
-    for (int ping = 0; ping < starboardDataAll.size(); ++ping) {
-        const std::vector<uint8_t>& samples = starboardDataAll[ping];
-        int idx = -1;
-        for (int i = 0; i < (int)samples.size() * 0.4; ++i) {
-            if (samples[i] > 0) {
-                int nonZeroCount = 0;
-                int checkRange = std::min(50, (int)(samples.size()*0.4) - i);
-                for (int k = 0; k < checkRange; ++k) {
-                    if (samples[i + k] > 0) nonZeroCount++;
-                }
-                if (nonZeroCount > checkRange*0.9) {
-                    idx = i;
-                    break;
-                }
-            }
-        }
-        if (idx < 0) idx = 0;
-        starboardBottomLine.append(idx);
-    }
-
-    // 平滑
-    portsmoothLine = smoothLine(portBottomLine, 100);
-    starboardsmoothLine = smoothLine(starboardBottomLine, 100);
+    tracker.trackCached(dataset->port(), dataset->starboard(), dataset->pingMeta(), dataset->productCache());
 
     qDebug() << "底部追踪完成，已绘制曲线";
 }
 
 void WaterlineDialog::doBottomTrackDisplay(bool drawPort, bool drawStarboard)
 {
-    if (!scene) return;
-
-    // 清理旧线（保留灰度图）
-    for (auto item : bottomLineItems) {
-        scene->removeItem(item);
-        delete item;
+    // 水线叠加在瀑布图上，只画可见的 ping
+    QVector<WaterfallOverlay> lines;
+    // 右舷从 sideWidth 列开始，数据集和 CLAHE 图的布局相同
+    const int portWidth = dataset ? SonogramGenerator::sideWidth(&dataset->port(), &dataset->starboard()) : 0;
+
+    if (drawPort && !tracker.portLine().isEmpty()) {
+        WaterfallOverlay line;
+        line.columns = tracker.portLine();
+        line.pen = QPen(Qt::red, 2);
+        lines.append(line);
     }
-    bottomLineItems.clear();
-
-    QPen pen(Qt::red, 3);
-    int portWidth = portDataAll.isEmpty() ? 0 : portDataAll[0].size();
 
-    if (drawPort && !portsmoothLine.isEmpty()) {
-        QPainterPath path;
-        path.moveTo(portsmoothLine[0], 0);
-        for (int ping = 1; ping < portsmoothLine.size(); ++ping) {
-            path.lineTo(portsmoothLine[ping], ping);
-        }
-        auto item = scene->addPath(path, pen);
-        bottomLineItems.append(item);
+    if (drawStarboard && !tracker.starboardLine().isEmpty() && portWidth > 0) {
+        WaterfallOverlay line;
+        line.columns = tracker.starboardLine();
+        line.offset = portWidth;
+        line.pen = QPen(Qt::red, 2);
+        lines.append(line);
     }
 
-    if (drawStarboard && !starboardsmoothLine.isEmpty() && portWidth > 0) {
-        QPainterPath path;
-        path.moveTo(portWidth + starboardsmoothLine[0], 0);
-        for (int ping = 1; ping < starboardsmoothLine.size(); ++ping) {
-            path.lineTo(portWidth + starboardsmoothLine[ping], ping);
-        }
-        auto item = scene->addPath(path, pen);
-        bottomLineItems.append(item);
-    }
-}
-
-QVector<int> WaterlineDialog::smoothLine(const QVector<int> &line, int window)
-{
-    QVector<int> smoothed(line.size());
-    for (int i = 0; i < line.size(); ++i) {
-        int sum = 0, count = 0;
-        for (int j = std::max(0, i-window); j <= std::min(i+window, line.size()-1); ++j) {
-            sum += line[j];
-            count++;
-        }
-        smoothed[i] = sum / count;
-    }
-    return smoothed;
-}
-
-int WaterlineDialog::findAppropriateStartIdx(const std::vector<uint8_t> &samples, int startIdx)
-{
-    if (samples.empty()) return -1;
-
-    int idx = startIdx;
-    if(startIdx == 0) return idx;
-    // 如果当前位置强度值过小，则尝试往前寻找更合适的点
-    if (samples[startIdx] == 0 || samples[startIdx-1] == 0) {
-        int candidate = -1;
-
-        // 1. 优先往前找第一个不为0的点
-        for (int i = startIdx; i >= 0; --i) {
-            if (samples[i] >= 3) {
-                candidate = i+1;
-                break;
-            }
-        }
-
-        // 2. 如果没有严格为0的点，找一个接近0的点（阈值 >=5）
-        if (candidate == -1) {
-            for (int i = startIdx; i >= 0; --i) {
-                if (samples[i] >= 5) {
-                    candidate = i+1;
-                    break;
-                }
-            }
-        }
-
-        if (candidate != -1) {
-            idx = candidate;
-        }
-    }
-
-    return idx;
+    ui->waterfallView->setOverlays(lines);
 }
 
 // ---------- 按钮和 slider 的槽 ----------
 void WaterlineDialog::on_horizontalSlider_valueChanged(int value)
 {
     double gamma = value / 100.0;
-    currentImage = SonogramGenerator::applyGamma(originalImage, gamma);
-
-    if (imageItem) {
-        imageItem->setPixmap(QPixmap::fromImage(currentImage));
-    }
+    showClahe(false);
+    pipeline.clear();
+    pipeline.addGamma(gamma);
+    updateColorTable();
 }
 
 //左舷水线显示
@@ -313,23 +127,44 @@ void WaterlineDialog::on_starboardRadio_clicked()
     doBottomTrackDisplay(false, true);
 }
 
+//切换水线追踪方式：高度引导 / 阈值搜索
+void WaterlineDialog::on_altitudeSeededCheckBox_toggled(bool checked)
+{
+    const BottomTracker::Mode mode = checked ? BottomTracker::AltitudeSeeded : BottomTracker::ThresholdSearch;
+    if (mode == tracker.mode()) return;
+
+    tracker.setMode(mode);
+    doBottomTrack();
+    doBottomTrackDisplay(ui->portRadio->isChecked(), ui->starboardRadio->isChecked());
+}
+
 //直方图均衡化
 void WaterlineDialog::on_HistoEqualize_clicked()
 {
-    currentImage = SonogramGenerator::applyHistogramEqualization(originalImage);
-
-    if (imageItem) {
-        imageItem->setPixmap(QPixmap::fromImage(currentImage));
-    }
+    showClahe(false);
+    pipeline.clear();
+    pipeline.addEqualize();
+    updateColorTable();
 }
 
 //归一化
 void WaterlineDialog::on_NormalizeBtn_clicked()
 {
-    currentImage = SonogramGenerator::applyNormalize(originalImage);
+    showClahe(false);
+    pipeline.clear();
+    pipeline.addNormalize();
+    updateColorTable();
+}
 
-    if (imageItem) {
-        imageItem->setPixmap(QPixmap::fromImage(currentImage));
-    }
+//限制对比度自适应直方图均衡化，和其他增强一样作用在原图上
+void WaterlineDialog::on_ClaheBtn_clicked()
+{
+    if (!dataset || (dataset->port().isEmpty() && dataset->starboard().isEmpty())) return;
+
+    // CLAHE 不是逐点操作，只有这里才需要整幅声图
+    if (claheImage.isEmpty()) claheImage = SonogramGenerator::applyClahe(dataset->baseSonogram());
+    showClahe(true);
+    pipeline.clear();
+    updateColorTable();
 }
 
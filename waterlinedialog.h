@@ -2,8 +2,10 @@
 #define WATERLINEDIALOG_H
 
 #include <QDialog>
-#include <QGraphicsScene>
-#include <QImage>
+#include "sonardataset.h"
+#include "tiledimage.h"
+#include "enhancementpipeline.h"
+#include "bottomtracker.h"
 
 namespace Ui {
 class WaterlineDialog;
@@ -18,46 +20,43 @@ public:
     ~WaterlineDialog();
 
     // 设置图像接口
-    void setData(const QVector<std::vector<uint8_t>>& port, const QVector<std::vector<uint8_t>>& starboard, const QImage& img);
+    void setData(const SonarDatasetPtr& data);
 
 private:
     Ui::WaterlineDialog *ui;
 
-    QGraphicsScene *scene;
-    QImage originalImage;   // 原始图像
-    QImage currentImage;    // 当前显示的图像
+    // 当前增强操作，复合成查找表后只更新颜色表，不处理像素
+    EnhancementPipeline pipeline;
+    TiledImage claheImage;      // CLAHE 结果，第一次使用时计算
+    bool claheShown = false;    // 当前显示的是否是 CLAHE 结果，否则直接显示数据集
+    qint64 imageHistogram[256];
+    bool histogramReady = false;
+
+    void updateColorTable();
+    // 显示 CLAHE 结果或原始数据
+    void showClahe(bool show);
 
     void updateView();
-    void fitToWidth(QGraphicsView* view, const QImage& image);
-    void showEvent(QShowEvent *event) override;
 
     // 底部追踪相关
-    QVector<std::vector<uint8_t>> portDataAll;
-    QVector<std::vector<uint8_t>> starboardDataAll;
-    QVector<int> portBottomLine;
-    QVector<int> starboardBottomLine;
-    QVector<int> portsmoothLine;
-    QVector<int> starboardsmoothLine;
-    QList<QGraphicsItem*> bottomLineItems;
+    SonarDatasetPtr dataset;   // 与主窗口共享，只读
+    BottomTracker tracker;
 
     void doBottomTrack();
     void doBottomTrackDisplay(bool drawPort, bool drawStarboard);
-    //移动平均平滑水线点
-    QVector<int> smoothLine(const QVector<int>& line, int window = 50);
-    //寻找合适的开始位置
-    int findAppropriateStartIdx(const std::vector<uint8_t>& samples, int startIdx);
-
-    QGraphicsPixmapItem* imageItem = nullptr;  // 灰度图
 
 private slots:
     void on_horizontalSlider_valueChanged(int value); //gamma矫正
 
     void on_portRadio_clicked();
     void on_starboardRadio_clicked();
+    void on_altitudeSeededCheckBox_toggled(bool checked);
 
     void on_HistoEqualize_clicked();
 
     void on_NormalizeBtn_clicked();
+
+    void on_ClaheBtn_clicked();
 };
 
 #endif // WATERLINEDIALOG_H
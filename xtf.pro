@@ -1,27 +1,61 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
 
+# SSE2 内核在所有 x86-64 上可用；确定运行机器支持 AVX2 时用 qmake CONFIG+=avx2 编译 AVX2 版本
+avx2 {
+    msvc: QMAKE_CXXFLAGS += /arch:AVX2
+    else: QMAKE_CXXFLAGS += -mavx2
+}
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    bottomtracker.cpp \
+    enhancementpipeline.cpp \
+    imagepyramid.cpp \
     main.cpp \
     mainwindow.cpp \
+    pingdecoder.cpp \
+    productcache.cpp \
+    sampleconverter.cpp \
+    slantrangecorrector.cpp \
     slantrangedialog.cpp \
+    sonardataset.cpp \
     sonogramgenerator.cpp \
+    tiledimage.cpp \
+    waterfallview.cpp \
     waterlinedialog.cpp \
+    xtfloadworker.cpp \
+    xtfmappedreader.cpp \
+    xtfpacketindex.cpp \
     xtfparse.cpp
 
 HEADERS += \
+    bottomtracker.h \
+    enhancementpipeline.h \
+    imagepyramid.h \
     mainwindow.h \
+    pingdecoder.h \
+    pingmatrix.h \
+    pingmeta.h \
+    productcache.h \
+    sampleconverter.h \
+    slantrangecorrector.h \
     slantrangedialog.h \
+    sonardataset.h \
     sonogramgenerator.h \
+    tiledimage.h \
+    waterfallview.h \
     waterlinedialog.h \
     xtf.h \
+    xtfloadworker.h \
+    xtfmappedreader.h \
+    xtfpacketindex.h \
     xtfparse.h
 
 FORMS += \
@@ -0,0 +1,63 @@
+#include "xtfloadworker.h"
+#include "xtfparse.h"
+#include <QDebug>
+
+XtfLoadWorker::XtfLoadWorker(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<PingBatch>("PingBatch");
+}
+
+void XtfLoadWorker::load(const QString &filePath)
+{
+    xtfparse parser;
+    parser.setKeepNativeSamples(keepNative);
+    parser.setChannelMask(channelMask);
+    parser.setSampleMapping(mapping);
+    parser.setFollowGrowth(followGrowth);
+    parser.setCancelFlag(&cancelled);
+    int lastPercent = -1;
+    bool waiting = false;   // 跟随模式：已追上写入进度，正在等待
+
+    if (preview) {
+        PingBatch overview;
+        int stride = 1;
+        if (parser.parsePreview(filePath, overview.port, overview.starboard, 4096, &stride) && !cancelled) {
+            emit previewReady(overview, stride);
+        }
+    }
+
+    bool completed = parser.parseXtfStreaming(filePath,
+        [&](PingMatrix& portBatch, PingMatrix& starboardBatch, NativeSamples& nativeBatch,
+            PingMetaTable& metaBatch, qint64 bytesDone, qint64 bytesTotal) {
+            if (cancelled) return false;
+            if (portBatch.isEmpty() && starboardBatch.isEmpty()) {
+                // 跟随模式的等待
+                if (!waiting) {
+                    waiting = true;
+                    emit reachedEnd();
+                }
+                return true;
+            }
+            waiting = false;
+
+            PingBatch batch;
+            batch.port = std::move(portBatch);
+            batch.starboard = std::move(starboardBatch);
+            batch.native = std::move(nativeBatch);
+            batch.meta = std::move(metaBatch);
+            emit batchReady(batch);
+
+            int percent = bytesTotal > 0 ? static_cast<int>(bytesDone * 100 / bytesTotal) : 0;
+            if (percent != lastPercent) {
+                lastPercent = percent;
+                emit progressChanged(percent);
+            }
+            return !cancelled;
+        });
+
+    if (!completed && !cancelled) {
+        qWarning() << "后台解析失败：" << filePath;
+    }
+    emit finished(completed);
+}
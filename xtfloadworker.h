@@ -0,0 +1,60 @@
+#ifndef XTFLOADWORKER_H
+#define XTFLOADWORKER_H
+
+#include <QObject>
+#include <QMetaType>
+#include <atomic>
+#include "pingmatrix.h"
+#include "pingmeta.h"
+#include "sampleconverter.h"
+
+// 后台解析时一次交给界面的一批 ping
+struct PingBatch {
+    PingMatrix port;
+    PingMatrix starboard;
+    NativeSamples native;   // 开启 setKeepNativeSamples 时的原始位深样本
+    PingMetaTable meta;     // 每个 ping 的参数
+};
+Q_DECLARE_METATYPE(PingBatch)
+
+// 在工作线程中流式解析 XTF 文件，分批通过信号把 ping 交给界面线程
+class XtfLoadWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit XtfLoadWorker(QObject* parent = nullptr);
+
+    // 请求取消，可在任意线程调用
+    void cancel() { cancelled = true; }
+
+    // 在 load() 之前设置
+    void setKeepNativeSamples(bool keep) { keepNative = keep; }
+    void setChannelMask(quint64 mask) { channelMask = mask; }
+    void setSampleMapping(const SampleMapping& m) { mapping = m; }
+    // 读到文件尾后继续跟随采集软件追加的数据，直到 cancel()
+    void setFollowGrowth(bool follow) { followGrowth = follow; }
+    // 完整读取之前先交出一张整条测线的低分辨率预览
+    void setPreviewEnabled(bool enabled) { preview = enabled; }
+
+public slots:
+    void load(const QString& filePath);
+
+signals:
+    // 预览只有左右舷样本，每 stride 个 ping 一行、横向每 stride 个样本一个
+    void previewReady(const PingBatch& preview, int stride);
+    void batchReady(const PingBatch& batch);
+    void progressChanged(int percent);
+    // 跟随模式下读到当前文件尾、开始等待新数据时发出（每次追上写入进度发一次）
+    void reachedEnd();
+    void finished(bool completed);   // completed 为 false 表示失败或被取消
+
+private:
+    std::atomic<bool> cancelled{false};
+    bool keepNative = false;
+    bool preview = false;
+    bool followGrowth = false;
+    quint64 channelMask = ~0ULL;
+    SampleMapping mapping;
+};
+
+#endif // XTFLOADWORKER_H
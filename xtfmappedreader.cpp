@@ -0,0 +1,231 @@
+#include "xtfmappedreader.h"
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+
+XtfMappedReader::XtfMappedReader()
+{
+}
+
+XtfMappedReader::~XtfMappedReader()
+{
+    close();
+}
+
+bool XtfMappedReader::open(const QString &filePath, bool scanAll)
+{
+    close();
+
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "无法打开文件：" << filePath;
+        return false;
+    }
+
+    mappedSize = file.size();
+    mapped = mappedSize > 0 ? file.map(0, mappedSize) : nullptr;
+    if (!mapped) {
+        qWarning() << "内存映射失败：" << filePath;
+        close();
+        return false;
+    }
+
+    if (!readFileHeader()) {
+        close();
+        return false;
+    }
+
+    indexedPath = filePath;
+    pingFirstChannel.append(0);
+
+    if (useIndexFile && index.load(filePath) && index.firstPacketOffset() == firstPacketOffset) {
+        scanComplete = true;
+        appendPings(0);
+        return true;
+    }
+
+    if (scanAll) {
+        index.build(mapped, mappedSize, firstPacketOffset, threadCount);
+        if (index.isCancelled()) {
+            close();
+            return false;
+        }
+        scanComplete = true;
+        if (useIndexFile) index.save(filePath, mappedSize);
+        appendPings(0);
+    } else {
+        index.begin(firstPacketOffset);
+    }
+    return true;
+}
+
+int XtfMappedReader::scanMore(int maxPings)
+{
+    if (!mapped || scanComplete) return 0;
+
+    const int firstPing = index.pingCount();
+    // 不限数量时剩余部分并行扫描
+    const int added = maxPings < 0 ? index.scanRest(mapped, mappedSize, threadCount)
+                                   : index.scanMore(mapped, mappedSize, maxPings);
+    if (!index.isCancelled() && (maxPings < 0 || added < maxPings)) {
+        scanComplete = true;
+        if (useIndexFile) index.save(indexedPath, mappedSize);
+    }
+
+    const int oldCount = pingOffsets.size();
+    appendPings(firstPing);
+    return pingOffsets.size() - oldCount;
+}
+
+bool XtfMappedReader::refresh()
+{
+    if (!mapped) return false;
+
+    const qint64 newSize = file.size();
+    if (newSize <= mappedSize) return false;
+
+    uchar* remapped = file.map(0, newSize);
+    if (!remapped) {
+        qWarning() << "重新映射失败：" << file.fileName();
+        return false;
+    }
+
+    // 已建立的通道视图指向旧映射区，按偏移平移
+    for (PingChannelView& channel : channelViews) {
+        const uchar* chanHeader = reinterpret_cast<const uchar*>(channel.chanHeader);
+        channel.chanHeader = reinterpret_cast<const XTFPINGCHANHEADER*>(remapped + (chanHeader - mapped));
+        channel.samples = remapped + (channel.samples - mapped);
+    }
+    file.unmap(mapped);
+    mapped = remapped;
+    mappedSize = newSize;
+    scanComplete = false;
+    return true;
+}
+
+void XtfMappedReader::close()
+{
+    if (mapped) {
+        file.unmap(mapped);
+        mapped = nullptr;
+    }
+    if (file.isOpen()) file.close();
+    mappedSize = 0;
+
+    header = XTFFILEHEADER{};
+    chanInfos.clear();
+    firstPacketOffset = 0;
+    index.clear();
+    indexedPath.clear();
+    scanComplete = false;
+    pingOffsets.clear();
+    pingFirstChannel.clear();
+    channelViews.clear();
+}
+
+QVector<int> XtfMappedReader::selectedChannels() const
+{
+    QVector<int> channels;
+    for (int i = 0; i < chanInfos.size(); ++i) {
+        if (isChannelSelected(channelMask, i)) channels.append(i);
+    }
+    return channels;
+}
+
+PingView XtfMappedReader::ping(int index) const
+{
+    PingView view;
+    if (index < 0 || index >= pingOffsets.size()) return view;
+
+    const qint64 offset = pingOffsets[index];
+    const int first = pingFirstChannel[index];
+    view.pingHeader = reinterpret_cast<const XTFPINGHEADER*>(mapped + offset);
+    view.channels = channelViews.constData() + first;
+    view.channelCount = pingFirstChannel[index + 1] - first;
+    view.offset = offset;
+    return view;
+}
+
+bool XtfMappedReader::readFileHeader()
+{
+    if (mappedSize < static_cast<qint64>(sizeof(XTFFILEHEADER))) {
+        qWarning() << "文件过小，不是 XTF 文件";
+        return false;
+    }
+
+    std::memcpy(&header, mapped, sizeof(XTFFILEHEADER));
+    if (header.FileFormat != 0x7B) {
+        qWarning() << "非标准 XTF 文件！";
+        return false;
+    }
+
+    firstPacketOffset = sizeof(XTFFILEHEADER);
+    int numChannels = header.NumberOfSonarChannels;
+    if (numChannels > 6) {
+        // 超过 6 个通道时，文件头后面按 1024 字节块追加 CHANINFO（每块 8 个）
+        firstPacketOffset += static_cast<qint64>(std::ceil((numChannels - 6) / 8.0) * 1024);
+    }
+    if (firstPacketOffset > mappedSize) {
+        qWarning() << "XTF 文件头不完整";
+        return false;
+    }
+
+    chanInfos.resize(numChannels);
+    for (int i = 0; i < numChannels; ++i) {
+        if (i < 6) {
+            chanInfos[i] = header.ChanInfo[i];
+        } else {
+            const uchar* p = mapped + sizeof(XTFFILEHEADER) + (i - 6) * sizeof(CHANINFO);
+            std::memcpy(&chanInfos[i], p, sizeof(CHANINFO));
+        }
+    }
+    return true;
+}
+
+void XtfMappedReader::appendPings(int firstPing)
+{
+    const int pingCount = index.pingCount();
+    pingOffsets.reserve(pingCount);
+    pingFirstChannel.reserve(pingCount + 1);
+    for (int i = firstPing; i < pingCount; ++i) {
+        const XtfPacketEntry& entry = index.ping(i);
+        appendPing(entry.offset, entry.offset + entry.size);
+    }
+}
+
+bool XtfMappedReader::appendPing(qint64 offset, qint64 recordEnd)
+{
+    qint64 pos = offset + sizeof(XTFPINGHEADER);
+    if (pos > recordEnd) return false;
+
+    const XTFPINGHEADER* pingHeader = reinterpret_cast<const XTFPINGHEADER*>(mapped + offset);
+    const int numChans = pingHeader->NumChansToFollow;
+    const int firstChannel = channelViews.size();
+
+    for (int i = 0; i < numChans; ++i) {
+        if (pos + static_cast<qint64>(sizeof(XTFPINGCHANHEADER)) > recordEnd) break;
+
+        PingChannelView channel;
+        channel.chanHeader = reinterpret_cast<const XTFPINGCHANHEADER*>(mapped + pos);
+        pos += sizeof(XTFPINGCHANHEADER);
+
+        channel.numSamples = channel.chanHeader->NumSamples;
+        channel.bytesPerSample = i < chanInfos.size() && chanInfos[i].BytesPerSample > 0
+                                     ? chanInfos[i].BytesPerSample : 1;
+        channel.channelNumber = i;
+        const qint64 sampleBytes = static_cast<qint64>(channel.numSamples) * channel.bytesPerSample;
+        if (pos + sampleBytes > recordEnd) {
+            qWarning() << "ping 通道数据越界，跳过该 ping，偏移：" << offset;
+            channelViews.resize(firstChannel);
+            return false;
+        }
+
+        channel.samples = mapped + pos;
+        pos += sampleBytes;     // 未选中的通道只跳过，不建立视图
+        if (isChannelSelected(channelMask, i)) channelViews.append(channel);
+    }
+
+    pingOffsets.append(offset);
+    pingFirstChannel.append(channelViews.size());
+    return true;
+}
@@ -0,0 +1,111 @@
+#ifndef XTFMAPPEDREADER_H
+#define XTFMAPPEDREADER_H
+
+#include <QFile>
+#include <QVector>
+#include <cstdint>
+#include "xtf.h"
+#include "xtfpacketindex.h"
+
+// 单个通道在映射区中的视图（只保存指针，不拷贝样本）
+struct PingChannelView {
+    const XTFPINGCHANHEADER* chanHeader = nullptr;
+    const uint8_t* samples = nullptr;   // 样本起始地址（未对齐，按小端读取）
+    uint32_t numSamples = 0;
+    uint16_t bytesPerSample = 1;
+    int channelNumber = 0;              // 在数据包中的通道序号
+};
+
+// 一个 ping 在映射区中的视图
+struct PingView {
+    const XTFPINGHEADER* pingHeader = nullptr;
+    const PingChannelView* channels = nullptr;   // 只包含通道掩码选中的通道
+    int channelCount = 0;
+    qint64 offset = 0;                  // 数据包在文件中的偏移
+};
+
+// 基于内存映射的 XTF 读取器：打开时只扫描一遍数据包（有有效索引文件时不扫描），
+// 之后每个 ping 都以指向映射区的视图形式随机访问
+class XtfMappedReader
+{
+public:
+    XtfMappedReader();
+    ~XtfMappedReader();
+
+    XtfMappedReader(const XtfMappedReader&) = delete;
+    XtfMappedReader& operator=(const XtfMappedReader&) = delete;
+
+    // 通道掩码：第 i 位为 1 表示保留第 i 个通道；第 64 个以后的通道只在全选时保留
+    static const quint64 AllChannels = ~0ULL;
+    static bool isChannelSelected(quint64 mask, int channel)
+    {
+        return mask == AllChannels || (channel < 64 && ((mask >> channel) & 1));
+    }
+
+    // 是否读写 .xtfidx 索引文件，默认开启
+    void setUseIndexFile(bool use) { useIndexFile = use; }
+    // 扫描数据包使用的线程数，1 为顺序扫描
+    void setThreadCount(int count) { threadCount = qMax(1, count); }
+    // 只为选中的通道建立视图，未选中通道的样本按字节数直接跳过，不会被读取。在 open() 之前设置
+    void setChannelMask(quint64 mask) { channelMask = mask; }
+    quint64 currentChannelMask() const { return channelMask; }
+    // 扫描数据包时检查的取消标志（可为空），置位后 open() / scanMore() 尽快返回，不写索引文件
+    void setCancelFlag(const std::atomic<bool>* flag) { index.setCancelFlag(flag); }
+
+    // 映射文件并建立 ping 视图，失败返回 false。
+    // scanAll 为 false 且没有有效索引文件时只映射文件，由调用者用 scanMore() 分批扫描
+    bool open(const QString& filePath, bool scanAll = true);
+    void close();
+    bool isOpen() const { return mapped != nullptr; }
+
+    // 继续扫描，最多再建立 maxPings 个 ping 视图（-1 不限，按 setThreadCount 并行扫描到文件尾），返回新增的 ping 数
+    int scanMore(int maxPings = -1);
+    // 已扫描到最后一个完整的包
+    bool isScanComplete() const { return scanComplete; }
+    // 最后一个完整包的末尾，之后的字节还没有建立视图
+    qint64 scannedBytes() const { return index.scannedBytes(); }
+
+    // 跟随仍在写入的文件：文件变大时重新映射（已有视图平移到新映射区），
+    // 之后 scanMore() 从最后一个完整包的末尾继续扫描。返回文件是否变大
+    bool refresh();
+
+    const XTFFILEHEADER& fileHeader() const { return header; }
+    // 全部声纳通道的通道信息（包括扩展头中第 6 个以后的通道）
+    const QVector<CHANINFO>& channelInfo() const { return chanInfos; }
+    // 选中的通道序号，PingView::channels 按这个顺序排列
+    QVector<int> selectedChannels() const;
+
+    int pingCount() const { return pingOffsets.size(); }
+    // 第 index 个 ping 的视图，O(1)
+    PingView ping(int index) const;
+
+    const XtfPacketIndex& packetIndex() const { return index; }
+
+    qint64 size() const { return mappedSize; }
+    const uchar* data() const { return mapped; }
+
+private:
+    bool readFileHeader();
+    void appendPings(int firstPing);
+    bool appendPing(qint64 offset, qint64 recordEnd);
+
+    QFile file;
+    uchar* mapped = nullptr;
+    qint64 mappedSize = 0;
+
+    XTFFILEHEADER header{};
+    QVector<CHANINFO> chanInfos;
+    qint64 firstPacketOffset = 0;
+
+    XtfPacketIndex index;
+    QString indexedPath;
+    bool useIndexFile = true;
+    bool scanComplete = false;
+    int threadCount = 1;
+    quint64 channelMask = AllChannels;
+    QVector<qint64> pingOffsets;             // 每个 ping 包的偏移
+    QVector<int> pingFirstChannel;           // 每个 ping 第一个通道在 channelViews 中的位置（多存一个结尾）
+    QVector<PingChannelView> channelViews;   // 所有 ping 的通道视图，按顺序平铺
+};
+
+#endif // XTFMAPPEDREADER_H
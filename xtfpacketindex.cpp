@@ -0,0 +1,342 @@
+#include "xtfpacketindex.h"
+#include "xtf.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+const char kIndexMagic[8] = {'X', 'T', 'F', 'I', 'D', 'X', '\0', '\0'};
+const uint32_t kIndexVersion = 1;
+
+// 重新同步时要求连续对上的包个数，避免把样本里偶然出现的 0xFACE 当成包头
+const int kResyncChainLength = 4;
+// 每个扫描区间的最小字节数，太小的文件不值得并行
+const qint64 kMinChunkBytes = 8 * 1024 * 1024;
+// 扫描时每隔多少个包检查一次取消标志
+const int kCancelCheckPackets = 4096;
+
+#pragma pack(push, 1)
+struct XtfIndexFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t entrySize;          // sizeof(XtfPacketEntry)，防止结构体变化后误读
+    qint64   sourceSize;         // XTF 文件大小
+    qint64   sourceModified;     // XTF 文件修改时间（毫秒）
+    qint64   firstPacketOffset;
+    qint64   scannedBytes;
+    quint64  entryCount;
+};
+#pragma pack(pop)
+
+// 公历日期转 1970-01-01 起的天数
+qint64 daysFromCivil(int y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const qint64 era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<qint64>(doe) - 719468;
+}
+
+qint64 toMSecs(int year, int month, int day, int hour, int minute, int second, int msec)
+{
+    if (year <= 0 || month < 1 || month > 12 || day < 1 || day > 31) return 0;
+    const qint64 days = daysFromCivil(year, month, day);
+    return ((days * 24 + hour) * 60 + minute) * 60000 + second * 1000 + msec;
+}
+
+} // namespace
+
+XtfPacketIndex::XtfPacketIndex()
+{
+}
+
+void XtfPacketIndex::build(const uchar *data, qint64 size, qint64 firstOffset, int threadCount)
+{
+    begin(firstOffset);
+    scanRest(data, size, threadCount);
+}
+
+int XtfPacketIndex::scanRest(const uchar *data, qint64 size, int threadCount)
+{
+    const qint64 maxChunks = (size - scanEnd) / kMinChunkBytes;
+    threadCount = static_cast<int>(qMin<qint64>(threadCount, maxChunks));
+    if (threadCount <= 1) return scanMore(data, size);
+
+    const int firstNew = entries.size();
+    const int oldPings = pingEntries.size();
+    buildParallel(data, size, threadCount);
+    appendPingEntries(firstNew);
+    return pingEntries.size() - oldPings;
+}
+
+void XtfPacketIndex::begin(qint64 firstOffset)
+{
+    clear();
+    this->firstOffset = firstOffset;
+    scanEnd = firstOffset;
+}
+
+int XtfPacketIndex::scanMore(const uchar *data, qint64 size, int maxPings)
+{
+    ScanChunk chunk;
+    chunk.rangeBegin = scanEnd;
+    chunk.rangeEnd = size;
+    scanRange(data, size, scanEnd, chunk, maxPings, cancelFlag);
+
+    const int firstNew = entries.size();
+    const int oldPings = pingEntries.size();
+    entries += chunk.entries;
+    scanEnd = chunk.end;
+    appendPingEntries(firstNew);
+    return pingEntries.size() - oldPings;
+}
+
+void XtfPacketIndex::buildParallel(const uchar *data, qint64 size, int threadCount)
+{
+    // 每个线程分几个区间，负载更均匀
+    const int chunkCount = threadCount * 4;
+    const qint64 from = scanEnd;    // 从上次停下的包边界继续
+    const qint64 chunkBytes = (size - from + chunkCount - 1) / chunkCount;
+
+    QVector<ScanChunk> chunks(chunkCount);
+    for (int i = 0; i < chunkCount; ++i) {
+        chunks[i].rangeBegin = from + i * chunkBytes;
+        chunks[i].rangeEnd = qMin(size, chunks[i].rangeBegin + chunkBytes);
+    }
+
+    QtConcurrent::blockingMap(chunks, [&](ScanChunk& chunk) {
+        // 第一个区间从已知的包边界开始，其余区间先重新同步
+        qint64 start = chunk.rangeBegin == from
+                           ? from
+                           : findPacketBoundary(data, size, chunk.rangeBegin, chunk.rangeEnd);
+        chunk.start = start;
+        if (start >= 0 && !isCancelled()) scanRange(data, size, start, chunk, -1, cancelFlag);
+    });
+    // 取消时各区间可能没扫完，不再拼接（否则会顺序重扫），索引停在原处
+    if (isCancelled()) return;
+
+    // 按顺序拼接：每个区间必须从上一个区间停下的位置开始，
+    // 对不上（误同步或上一区间的包跨过了整个区间）就从该位置顺序重扫本区间
+    qint64 expected = from;
+    int total = entries.size();
+    for (const ScanChunk& chunk : chunks) total += chunk.entries.size();
+    entries.reserve(total);
+
+    for (ScanChunk& chunk : chunks) {
+        if (chunk.start != expected) {
+            ScanChunk rescan;
+            rescan.rangeBegin = chunk.rangeBegin;
+            rescan.rangeEnd = chunk.rangeEnd;
+            rescan.start = expected;
+            scanRange(data, size, expected, rescan, -1, cancelFlag);
+            chunk = std::move(rescan);
+        }
+
+        entries += chunk.entries;
+        expected = chunk.end;
+        if (chunk.stopped) break;
+    }
+    scanEnd = expected;
+}
+
+void XtfPacketIndex::scanRange(const uchar *data, qint64 size, qint64 offset, ScanChunk &chunk, int maxPings,
+                               const std::atomic<bool> *cancel)
+{
+    chunk.stopped = false;
+    int pings = 0;
+    while (offset < chunk.rangeEnd && (maxPings < 0 || pings < maxPings)) {
+        if (cancel && chunk.entries.size() % kCancelCheckPackets == 0 && cancel->load()) {
+            chunk.stopped = true;
+            break;
+        }
+        if (offset + static_cast<qint64>(sizeof(XTFCHANHEADER)) > size) {
+            chunk.stopped = true;
+            break;
+        }
+        const XTFCHANHEADER* chanHeader = reinterpret_cast<const XTFCHANHEADER*>(data + offset);
+        const qint64 recordSize = chanHeader->NumBytesThisRecord;
+        if (chanHeader->MagicNumber != 0xFACE
+            || recordSize < static_cast<qint64>(sizeof(XTFCHANHEADER))
+            || offset + recordSize > size) {    // 无效包或最后一个包不完整
+            chunk.stopped = true;
+            break;
+        }
+
+        XtfPacketEntry entry{};
+        entry.offset = offset;
+        entry.size = chanHeader->NumBytesThisRecord;
+        entry.headerType = chanHeader->HeaderType;
+        entry.subChannel = chanHeader->SubChannelNumber;
+        entry.numChans = chanHeader->NumChansToFollow;
+        if (entry.headerType == XTF_HEADER_SONAR && recordSize >= static_cast<qint64>(sizeof(XTFPINGHEADER))) {
+            entry.pingNumber = reinterpret_cast<const XTFPINGHEADER*>(data + offset)->PingNumber;
+        }
+        if (entry.headerType == XTF_HEADER_SONAR) ++pings;
+        entry.timestamp = packetTimestamp(data + offset, entry.headerType, recordSize);
+        chunk.entries.append(entry);
+
+        offset += recordSize;
+    }
+    chunk.end = offset;
+}
+
+bool XtfPacketIndex::isPacketBoundary(const uchar *data, qint64 size, qint64 offset)
+{
+    for (int k = 0; k < kResyncChainLength; ++k) {
+        if (offset == size) return k > 0;      // 正好接到文件尾
+        if (offset + static_cast<qint64>(sizeof(XTFCHANHEADER)) > size) return k > 0;
+
+        const XTFCHANHEADER* chanHeader = reinterpret_cast<const XTFCHANHEADER*>(data + offset);
+        const qint64 recordSize = chanHeader->NumBytesThisRecord;
+        if (chanHeader->MagicNumber != 0xFACE) return false;
+        if (recordSize < static_cast<qint64>(sizeof(XTFCHANHEADER))) return false;
+        if (offset + recordSize > size) return k > 0;  // 文件尾不完整的包
+        offset += recordSize;
+    }
+    return true;
+}
+
+qint64 XtfPacketIndex::findPacketBoundary(const uchar *data, qint64 size, qint64 from, qint64 to)
+{
+    // 0xFACE 按小端存储为 CE FA
+    const qint64 last = qMin(to, size - 1);
+    qint64 pos = from;
+    while (pos < last) {
+        const void* hit = std::memchr(data + pos, 0xCE, static_cast<size_t>(last - pos));
+        if (!hit) break;
+        pos = static_cast<const uchar*>(hit) - data;
+        if (data[pos + 1] == 0xFA && isPacketBoundary(data, size, pos)) return pos;
+        ++pos;
+    }
+    return -1;
+}
+
+bool XtfPacketIndex::load(const QString &xtfPath)
+{
+    clear();
+
+    QFileInfo info(xtfPath);
+    QFile file(indexPathFor(xtfPath));
+    if (!info.exists() || !file.open(QIODevice::ReadOnly)) return false;
+
+    XtfIndexFileHeader fileHeader{};
+    if (file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader)) != sizeof(fileHeader))
+        return false;
+
+    if (std::memcmp(fileHeader.magic, kIndexMagic, sizeof(kIndexMagic)) != 0
+        || fileHeader.version != kIndexVersion
+        || fileHeader.entrySize != sizeof(XtfPacketEntry)) {
+        qDebug() << "索引文件格式不匹配：" << file.fileName();
+        return false;
+    }
+    if (fileHeader.sourceSize != info.size()
+        || fileHeader.sourceModified != info.lastModified().toMSecsSinceEpoch()) {
+        qDebug() << "XTF 文件已变化，索引失效：" << file.fileName();
+        return false;
+    }
+
+    const qint64 bytes = static_cast<qint64>(fileHeader.entryCount) * sizeof(XtfPacketEntry);
+    if (bytes != file.size() - static_cast<qint64>(sizeof(fileHeader))) {
+        qWarning() << "索引文件长度错误：" << file.fileName();
+        return false;
+    }
+
+    entries.resize(static_cast<int>(fileHeader.entryCount));
+    if (file.read(reinterpret_cast<char*>(entries.data()), bytes) != bytes) {
+        clear();
+        return false;
+    }
+
+    firstOffset = fileHeader.firstPacketOffset;
+    scanEnd = fileHeader.scannedBytes;
+    appendPingEntries(0);
+    return true;
+}
+
+bool XtfPacketIndex::save(const QString &xtfPath, qint64 sourceSize) const
+{
+    QFileInfo info(xtfPath);
+    if (!info.exists()) return false;
+    if (info.size() != sourceSize) {
+        qDebug() << "文件在扫描期间变大，不写索引：" << xtfPath;
+        return false;
+    }
+
+    XtfIndexFileHeader fileHeader{};
+    std::memcpy(fileHeader.magic, kIndexMagic, sizeof(kIndexMagic));
+    fileHeader.version = kIndexVersion;
+    fileHeader.entrySize = sizeof(XtfPacketEntry);
+    fileHeader.sourceSize = sourceSize;
+    fileHeader.sourceModified = info.lastModified().toMSecsSinceEpoch();
+    fileHeader.firstPacketOffset = firstOffset;
+    fileHeader.scannedBytes = scanEnd;
+    fileHeader.entryCount = static_cast<quint64>(entries.size());
+
+    QSaveFile file(indexPathFor(xtfPath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "无法写入索引文件：" << file.fileName();
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    file.write(reinterpret_cast<const char*>(entries.constData()),
+               static_cast<qint64>(entries.size()) * sizeof(XtfPacketEntry));
+    return file.commit();
+}
+
+void XtfPacketIndex::clear()
+{
+    entries.clear();
+    pingEntries.clear();
+    firstOffset = 0;
+    scanEnd = 0;
+}
+
+QString XtfPacketIndex::indexPathFor(const QString &xtfPath)
+{
+    QFileInfo info(xtfPath);
+    QFileInfo dirInfo(info.absolutePath());
+    if (dirInfo.isWritable()) {
+        return info.absoluteFilePath() + ".xtfidx";
+    }
+
+    // 只读目录（光盘、网络共享等）：按绝对路径哈希放到缓存目录
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/xtfidx";
+    QDir().mkpath(cacheDir);
+    QByteArray key = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(), QCryptographicHash::Md5).toHex();
+    return cacheDir + "/" + QString::fromLatin1(key) + ".xtfidx";
+}
+
+qint64 XtfPacketIndex::packetTimestamp(const uchar *packet, uint8_t headerType, qint64 available)
+{
+    if (headerType == XTF_HEADER_ATTITUDE) {
+        if (available < static_cast<qint64>(sizeof(XTFAttitudeData))) return 0;
+        const XTFAttitudeData* att = reinterpret_cast<const XTFAttitudeData*>(packet);
+        if (att->SourceEpoch > 0)
+            return static_cast<qint64>(att->SourceEpoch) * 1000 + att->EpochMicroseconds / 1000;
+        return toMSecs(att->Year, att->Month, att->Day, att->Hour, att->Minutes, att->Seconds, att->Milliseconds);
+    }
+
+    // 其余常见包头在字节14-21处与 XTFPINGHEADER 的时间字段布局一致
+    const qint64 timeEnd = offsetof(XTFPINGHEADER, HSeconds) + 1;
+    if (available < timeEnd) return 0;
+    const XTFPINGHEADER* ping = reinterpret_cast<const XTFPINGHEADER*>(packet);
+    return toMSecs(ping->Year, ping->Month, ping->Day, ping->Hour, ping->Minute, ping->Second, ping->HSeconds * 10);
+}
+
+void XtfPacketIndex::appendPingEntries(int fromEntry)
+{
+    for (int i = fromEntry; i < entries.size(); ++i) {
+        if (entries[i].headerType == XTF_HEADER_SONAR) pingEntries.append(i);
+    }
+}
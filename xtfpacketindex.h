@@ -0,0 +1,95 @@
+#ifndef XTFPACKETINDEX_H
+#define XTFPACKETINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <cstdint>
+
+#pragma pack(push, 1)  // 索引文件中按原样写出，保持1字节对齐
+
+// 一条数据包索引记录
+struct XtfPacketEntry {
+    qint64   offset;        // 数据包在文件中的偏移
+    uint32_t size;          // NumBytesThisRecord
+    uint8_t  headerType;    // HeaderType
+    uint8_t  subChannel;    // SubChannelNumber
+    uint16_t numChans;      // NumChansToFollow
+    uint32_t pingNumber;    // Ping号（非侧扫包为0）
+    qint64   timestamp;     // UTC 毫秒时间戳（无时间信息为0）
+};
+
+#pragma pack(pop)
+
+// XTF 数据包偏移索引：一次扫描记录所有 0xFACE 包，
+// 以 <文件名>.xtfidx 旁路文件（或缓存目录）保存，按文件大小和修改时间校验
+class XtfPacketIndex
+{
+public:
+    XtfPacketIndex();
+
+    // 从映射区 firstOffset 处开始扫描，直到遇到无效或不完整的包。
+    // threadCount > 1 时把文件切成若干字节区间，各区间先重新同步到 0xFACE 包边界再并行扫描
+    void build(const uchar* data, qint64 size, qint64 firstOffset, int threadCount = 1);
+
+    // 增量扫描：begin() 清空索引，scanMore() 从上次停下的位置继续，
+    // 最多再记录 maxPings 个侧扫 ping（-1 不限），返回新增的 ping 数
+    void begin(qint64 firstOffset);
+    int scanMore(const uchar* data, qint64 size, int maxPings = -1);
+    // 从上次停下的位置并行扫描到文件尾，剩余部分较小时顺序扫描。返回新增的 ping 数
+    int scanRest(const uchar* data, qint64 size, int threadCount);
+
+    // 读取 / 写入与 xtfPath 对应的索引文件，校验失败返回 false。
+    // sourceSize 为扫描时映射的文件大小，文件在扫描后又变大时不写索引，以免缺少尾部的包却通过校验
+    bool load(const QString& xtfPath);
+    bool save(const QString& xtfPath, qint64 sourceSize) const;
+
+    void clear();
+    bool isEmpty() const { return entries.isEmpty(); }
+
+    // 扫描时检查的取消标志（可为空）。置位后扫描尽快停止，这时的索引不完整，不应保存
+    void setCancelFlag(const std::atomic<bool>* flag) { cancelFlag = flag; }
+    bool isCancelled() const { return cancelFlag && cancelFlag->load(); }
+
+    const QVector<XtfPacketEntry>& packets() const { return entries; }
+    int pingCount() const { return pingEntries.size(); }
+    // 第 n 个侧扫 ping 的记录，O(1)
+    const XtfPacketEntry& ping(int n) const { return entries[pingEntries[n]]; }
+
+    qint64 firstPacketOffset() const { return firstOffset; }
+    // 扫描停止的位置（最后一个完整包的末尾）
+    qint64 scannedBytes() const { return scanEnd; }
+
+    // 索引文件路径：优先放在 XTF 文件旁边，目录不可写时放到缓存目录
+    static QString indexPathFor(const QString& xtfPath);
+
+private:
+    // 一个字节区间的扫描结果
+    struct ScanChunk {
+        qint64 rangeBegin = 0;
+        qint64 rangeEnd = 0;
+        qint64 start = -1;      // 区间内第一个包的偏移（-1 表示没找到）
+        qint64 end = -1;        // 扫描停止的位置
+        bool stopped = false;   // 遇到无效或不完整的包而提前停止
+        QVector<XtfPacketEntry> entries;
+    };
+
+    // 从 offset 开始顺序扫描，直到包起点 >= rangeEnd、遇到无效包、已记录 maxPings 个 ping 或 cancel 置位
+    static void scanRange(const uchar* data, qint64 size, qint64 offset, ScanChunk& chunk, int maxPings = -1,
+                          const std::atomic<bool>* cancel = nullptr);
+    // offset 处是否为真正的包边界（魔数合法，且之后连续几个包首尾相接）
+    static bool isPacketBoundary(const uchar* data, qint64 size, qint64 offset);
+    static qint64 findPacketBoundary(const uchar* data, qint64 size, qint64 from, qint64 to);
+
+    void buildParallel(const uchar* data, qint64 size, int threadCount);
+    static qint64 packetTimestamp(const uchar* packet, uint8_t headerType, qint64 available);
+    void appendPingEntries(int fromEntry);
+
+    QVector<XtfPacketEntry> entries;
+    QVector<int> pingEntries;       // 侧扫 ping 在 entries 中的位置
+    qint64 firstOffset = 0;
+    qint64 scanEnd = 0;
+    const std::atomic<bool>* cancelFlag = nullptr;
+};
+
+#endif // XTFPACKETINDEX_H
@@ -2,11 +2,55 @@
 #include <QDebug>
 #include <fstream>
 #include <cmath>
+#include <cstring>
+#include <QtEndian>
+#include <QThread>
+#include <QtConcurrent>
+#include <QDateTime>
 #include "xtfparse.h"
+#include "xtfmappedreader.h"
+#include "pingdecoder.h"
+
+namespace {
+
+// 在 native 中为一舷追加一行原始样本，返回按字节访问的行首；不保留时返回 nullptr
+uint8_t* appendNativeRow(NativeSamples& native, int side, int numSamples)
+{
+    if (native.bytesPerSample == 2)
+        return reinterpret_cast<uint8_t*>((side == 0 ? native.port16 : native.starboard16).appendRow(numSamples));
+    if (native.bytesPerSample == 4)
+        return reinterpret_cast<uint8_t*>((side == 0 ? native.port32 : native.starboard32).appendRow(numSamples));
+    return nullptr;
+}
+
+// native 中一舷第 row 行的行首
+uint8_t* nativeRow(NativeSamples& native, int side, int row)
+{
+    if (native.bytesPerSample == 2)
+        return reinterpret_cast<uint8_t*>((side == 0 ? native.port16 : native.starboard16).row(row));
+    if (native.bytesPerSample == 4)
+        return reinterpret_cast<uint8_t*>((side == 0 ? native.port32 : native.starboard32).row(row));
+    return nullptr;
+}
+
+// 前 channelCount 个选中通道的样本位宽，用于选择解码器
+QVector<int> channelWidths(const XtfMappedReader& reader, int channelCount)
+{
+    const QVector<int> selected = reader.selectedChannels();
+    QVector<int> widths;
+    for (int i = 0; i < qMin(channelCount, selected.size()); ++i) {
+        const int bytes = reader.channelInfo()[selected[i]].BytesPerSample;
+        widths.append(bytes > 0 ? bytes : 1);
+    }
+    return widths;
+}
+
+} // namespace
 
 xtfparse::xtfparse(QObject* parent)
     : QObject(parent)
 {
+    setThreadCount(QThread::idealThreadCount());
 }
 
 xtfparse::~xtfparse()
@@ -14,7 +58,297 @@ xtfparse::~xtfparse()
 
 }
 
-void xtfparse::parseXtfHeader(const QString &filePath, QVector<std::vector<uint8_t> > &portData, QVector<std::vector<uint8_t> > &starboardData)
+void xtfparse::setThreadCount(int count)
+{
+    parseThreads = qMax(1, count);
+}
+
+int xtfparse::nativeBytesFor(const QVector<int> &widths) const
+{
+    if (!keepNative) return 0;
+
+    int bytes = 0;
+    for (int i = 0; i < qMin(widths.size(), 2); ++i) {
+        bytes = qMax(bytes, widths[i]);
+    }
+    if (bytes >= 4) return 4;
+    return bytes == 2 ? 2 : 0;   // 8 位数据没有必要另外保留
+}
+
+void xtfparse::parseXtfHeader(const QString &filePath, PingMatrix &portData, PingMatrix &starboardData,
+                              NativeSamples *native)
+{
+    if (native) native->clear();
+    NativeSamples* keep = keepNative ? native : nullptr;
+
+    QVector<PingMatrix> channels;
+    if (readMode == MappedRead && parseMapped(filePath, channels, 2, keep)) {
+        portData = channels.size() > 0 ? std::move(channels[0]) : PingMatrix();        // 左舷
+        starboardData = channels.size() > 1 ? std::move(channels[1]) : PingMatrix();   // 右舷
+        return;
+    }
+
+    parseStream(filePath, portData, starboardData, keep);
+}
+
+bool xtfparse::parseAllChannels(const QString &filePath, QVector<PingMatrix> &channels, NativeSamples *native)
+{
+    if (native) native->clear();
+    return parseMapped(filePath, channels, -1, keepNative ? native : nullptr);
+}
+
+bool xtfparse::parseMapped(const QString &filePath, QVector<PingMatrix> &channels, int channelLimit,
+                           NativeSamples *native)
+{
+    XtfMappedReader reader;
+    reader.setThreadCount(parseThreads);
+    reader.setChannelMask(channelMask);
+    reader.setCancelFlag(cancelFlag);
+    if (!reader.open(filePath)) {
+        qWarning() << "内存映射读取失败，改用流式读取";
+        return false;
+    }
+
+    const XTFFILEHEADER& header = reader.fileHeader();
+    qDebug() << "Header.NumberOfSonarChannels:" << header.NumberOfSonarChannels;
+
+    const int pingCount = reader.pingCount();
+    const int selectedCount = reader.selectedChannels().size();
+    const int channelCount = channelLimit < 0 ? selectedCount : qMin(channelLimit, selectedCount);
+    metaTable.clear();
+    const QVector<int> widths = channelWidths(reader, channelCount);
+    const PingDecoder decoder(widths);
+
+    channels.resize(channelCount);
+    QVector<PingMatrix*> targets;
+    for (int c = 0; c < channelCount; ++c) {
+        channels[c].clear();
+        targets.append(&channels[c]);
+    }
+
+    NativeSamples unused;
+    NativeSamples& nativeData = native ? *native : unused;
+    nativeData.clear();
+    nativeData.bytesPerSample = native ? nativeBytesFor(widths) : 0;
+
+    decodePings(reader, 0, pingCount, decoder, targets, nativeData, metaTable);
+    return true;
+}
+
+void xtfparse::decodePings(const XtfMappedReader &reader, int first, int end, const PingDecoder &decoder,
+                           const QVector<PingMatrix*> &channels, NativeSamples &native, PingMetaTable &meta)
+{
+    const int pingCount = end - first;
+    const int channelCount = channels.size();
+    if (pingCount <= 0) return;
+
+    // 先按视图中的样本数分配各通道的行，每个 ping 的行位置预先确定，
+    // 各线程直接解码到自己的行里，互不干扰
+    std::vector<qint64> totals(channelCount, 0);
+    for (int p = first; p < end; ++p) {
+        const PingView ping = reader.ping(p);
+        for (int c = 0; c < qMin(ping.channelCount, channelCount); ++c) {
+            totals[c] += ping.channels[c].numSamples;
+        }
+    }
+    for (int c = 0; c < channelCount; ++c) {
+        channels[c]->reserve(channels[c]->rows() + pingCount, channels[c]->totalSamples() + totals[c]);
+    }
+
+    // rowIndex[i * channelCount + c]：第 first + i 个 ping 的通道 c 在矩阵中的行号，-1 表示该 ping 没有这个通道
+    std::vector<int> rowIndex(static_cast<size_t>(pingCount) * channelCount, -1);
+    for (int p = first; p < end; ++p) {
+        const PingView ping = reader.ping(p);
+        for (int c = 0; c < qMin(ping.channelCount, channelCount); ++c) {
+            const int numSamples = ping.channels[c].numSamples;
+            rowIndex[static_cast<size_t>(p - first) * channelCount + c] = channels[c]->rows();
+            channels[c]->appendRow(numSamples);
+            if (c < 2) appendNativeRow(native, c, numSamples);   // 只保留左右舷的原始样本
+        }
+    }
+
+    std::vector<PingMeta> metaSlots(static_cast<size_t>(pingCount));   // 每个 ping 取第一个选中通道的参数
+    auto decodeRange = [&](const QPair<int, int>& range) {
+        PingRowTargets rows;
+        rows.reset(channelCount);
+        rows.nativeBytes = native.bytesPerSample;
+        for (int i = range.first; i < range.second; ++i) {
+            for (int c = 0; c < channelCount; ++c) {
+                const int row = rowIndex[static_cast<size_t>(i) * channelCount + c];
+                rows.display[c] = row >= 0 ? channels[c]->row(row) : nullptr;
+                rows.native[c] = row >= 0 && c < 2 ? nativeRow(native, c, row) : nullptr;
+            }
+            decodePing(reader.ping(first + i), decoder, rows, 1, &metaSlots[static_cast<size_t>(i)]);
+        }
+    };
+
+    // 按 ping 切块并行解码
+    QVector<QPair<int, int>> ranges;
+    const int chunkCount = parseThreads > 1 ? parseThreads * 4 : 1;
+    const int chunkSize = qMax(1, (pingCount + chunkCount - 1) / chunkCount);
+    for (int begin = 0; begin < pingCount; begin += chunkSize) {
+        ranges.append(qMakePair(begin, qMin(pingCount, begin + chunkSize)));
+    }
+    if (ranges.size() > 1) {
+        QtConcurrent::blockingMap(ranges, decodeRange);
+    } else {
+        decodeRange(ranges.first());
+    }
+
+    // 参数表与左舷行对齐：没有左舷通道的 ping 不占行
+    for (int i = 0; i < pingCount && channelCount > 0; ++i) {
+        if (rowIndex[static_cast<size_t>(i) * channelCount] >= 0) meta.append(metaSlots[static_cast<size_t>(i)]);
+    }
+}
+
+bool xtfparse::parseXtfStreaming(const QString &filePath, const PingBatchCallback &onBatch, int firstBatchSize, int batchSize)
+{
+    XtfMappedReader reader;
+    reader.setThreadCount(parseThreads);
+    reader.setChannelMask(channelMask);
+    reader.setCancelFlag(cancelFlag);
+    if (!reader.open(filePath, false)) return false;
+
+    const XTFFILEHEADER& header = reader.fileHeader();
+    const int channelCount = qMin(2, reader.selectedChannels().size());   // 只解码左右舷
+    const QVector<int> widths = channelWidths(reader, channelCount);
+    const int nativeBytes = nativeBytesFor(widths);
+    const PingDecoder decoder(widths);
+    metaTable.clear();
+
+    int decoded = 0;
+    int wanted = firstBatchSize;
+    while (true) {
+        // 没有现成索引时先只扫描第一批，尽快交出；之后剩余部分一次并行扫描完
+        if (reader.pingCount() - decoded < wanted && !reader.isScanComplete()) {
+            reader.scanMore(decoded == 0 ? wanted - reader.pingCount() : -1);
+            if (isCancelled()) return false;
+        }
+
+        const int end = qMin(reader.pingCount(), decoded + wanted);
+        if (end == decoded) {
+            if (!followGrowth) break;
+
+            // 跟随模式：文件还在写入，不再反复写索引文件；等文件变大后从最后一个完整包继续
+            reader.setUseIndexFile(false);
+            QThread::msleep(static_cast<unsigned long>(followInterval));
+            reader.refresh();
+            PingMatrix noPort, noStarboard;
+            NativeSamples noNative;
+            PingMetaTable noMeta;
+            if (!onBatch(noPort, noStarboard, noNative, noMeta, reader.scannedBytes(), reader.size())) return false;
+            continue;
+        }
+
+        PingMatrix portBatch, starboardBatch;
+        NativeSamples nativeBatch;
+        nativeBatch.bytesPerSample = nativeBytes;
+        PingMetaTable metaBatch;
+        QVector<PingMatrix*> targets;
+        if (channelCount > 0) targets.append(&portBatch);
+        if (channelCount > 1) targets.append(&starboardBatch);
+        decodePings(reader, decoded, end, decoder, targets, nativeBatch, metaBatch);
+
+        const PingView last = reader.ping(end - 1);
+        const qint64 bytesDone = last.offset + last.pingHeader->NumBytesThisRecord;
+        decoded = end;
+        wanted = batchSize;
+        metaTable.append(metaBatch);
+
+        if (!onBatch(portBatch, starboardBatch, nativeBatch, metaBatch, bytesDone, reader.size())) return false;
+    }
+    return true;
+}
+
+bool xtfparse::parsePreview(const QString &filePath, PingMatrix &portPreview, PingMatrix &starboardPreview,
+                            int maxPings, int *strideOut)
+{
+    portPreview.clear();
+    starboardPreview.clear();
+
+    XtfMappedReader reader;
+    reader.setThreadCount(parseThreads);
+    reader.setChannelMask(channelMask);
+    reader.setCancelFlag(cancelFlag);
+    if (!reader.open(filePath)) return false;
+
+    const int pingCount = reader.pingCount();
+    const int channelCount = qMin(2, reader.selectedChannels().size());   // 只看左右舷
+    if (pingCount == 0 || channelCount == 0) return false;
+
+    const int stride = qMax(1, (pingCount + maxPings - 1) / qMax(1, maxPings));
+    const int rowCount = (pingCount + stride - 1) / stride;
+    if (strideOut) *strideOut = stride;
+
+    // 先按降采样后的样本数分配好所有行，再并行填充
+    PingMatrix* previews[2] = {&portPreview, &starboardPreview};
+    std::vector<int> rowIndex(static_cast<size_t>(rowCount) * 2, -1);
+    for (int r = 0; r < rowCount; ++r) {
+        const PingView ping = reader.ping(r * stride);
+        for (int side = 0; side < qMin(ping.channelCount, channelCount); ++side) {
+            rowIndex[static_cast<size_t>(r) * 2 + side] = previews[side]->rows();
+            previews[side]->appendRow((ping.channels[side].numSamples + stride - 1) / stride);
+        }
+    }
+
+    const PingDecoder decoder(channelWidths(reader, channelCount));
+    auto decodeRange = [&](const QPair<int, int>& range) {
+        std::vector<uint8_t> full[2];
+        PingRowTargets rows;
+        for (int r = range.first; r < range.second && !isCancelled(); ++r) {
+            const PingView ping = reader.ping(r * stride);
+            rows.reset(channelCount);
+            for (int side = 0; side < qMin(ping.channelCount, channelCount); ++side) {
+                full[side].resize(ping.channels[side].numSamples);
+                rows.display[side] = full[side].data();
+            }
+            decoder.decode(ping, converter, rows);
+
+            // 横向每 stride 个样本取最大值，保留强回波
+            for (int side = 0; side < qMin(ping.channelCount, channelCount); ++side) {
+                const int row = rowIndex[static_cast<size_t>(r) * 2 + side];
+                uint8_t* out = previews[side]->row(row);
+                const int count = static_cast<int>(full[side].size());
+                for (int x = 0; x < previews[side]->rowSize(row); ++x) {
+                    const int end = qMin(count, (x + 1) * stride);
+                    uint8_t strongest = 0;
+                    for (int i = x * stride; i < end; ++i) strongest = qMax(strongest, full[side][i]);
+                    out[x] = strongest;
+                }
+            }
+        }
+    };
+
+    // 按行切块并行解码，与 parseMapped 相同
+    QVector<QPair<int, int>> ranges;
+    const int chunkCount = parseThreads > 1 ? parseThreads * 4 : 1;
+    const int chunkSize = qMax(1, (rowCount + chunkCount - 1) / chunkCount);
+    for (int begin = 0; begin < rowCount; begin += chunkSize) {
+        ranges.append(qMakePair(begin, qMin(rowCount, begin + chunkSize)));
+    }
+    if (ranges.size() > 1) {
+        QtConcurrent::blockingMap(ranges, decodeRange);
+    } else {
+        decodeRange(ranges.first());
+    }
+    return !isCancelled();
+}
+
+int xtfparse::decodePing(const PingView &ping, const PingDecoder &decoder, const PingRowTargets &rows,
+                         int metaChannels, PingMeta *metas)
+{
+    //提取并保存每个 ping 的参数
+    const int metaCount = qMin(ping.channelCount, metaChannels);
+    for (int i = 0; i < metaCount; i++) {
+        metas[i] = extractPingMeta(*ping.pingHeader, *ping.channels[i].chanHeader);
+    }
+
+    decoder.decode(ping, converter, rows);
+    return metaCount;
+}
+
+void xtfparse::parseStream(const QString &filePath, PingMatrix &portData, PingMatrix &starboardData,
+                           NativeSamples *native)
 {
     std::ifstream file(filePath.toStdString(), std::ios::binary);
     if (!file) {
@@ -33,25 +367,42 @@ void xtfparse::parseXtfHeader(const QString &filePath, QVector<std::vector<uint8
     qDebug() << "Header.NumberOfSonarChannels:" << header.NumberOfSonarChannels;
 
     if (header.NumberOfSonarChannels > 6) {
-        int moveIndex = static_cast<int>(ceil((header.NumberOfSonarChannels - 6) / 8.0) * 1024);
+        std::streamoff moveIndex = static_cast<std::streamoff>(ceil((header.NumberOfSonarChannels - 6) / 8.0) * 1024);
         file.seekg(moveIndex, std::ios::cur);
     }
 
     portData.clear();
     starboardData.clear();
+    metaTable.clear();
+
+    // 选中通道的样本位宽（流式读取只看文件头中的前 6 个通道）
+    QVector<int> widths;
+    for (int i = 0; i < header.NumberOfSonarChannels && i < 6; i++) {
+        if (XtfMappedReader::isChannelSelected(channelMask, i)) widths.append(qMax<int>(1, header.ChanInfo[i].BytesPerSample));
+    }
+
+    NativeSamples unused;
+    NativeSamples& nativeData = native ? *native : unused;
+    nativeData.clear();
+    nativeData.bytesPerSample = native ? nativeBytesFor(widths) : 0;
+    std::vector<uint8_t> rawSamples;
 
     while (!file.eof()) {
+        // 包起点用 64 位的 streampos 记录，超过 2GB 的文件也能正确定位
+        const std::streampos packetStart = file.tellg();
         XTFCHANHEADER chanHeader{};
         file.read(reinterpret_cast<char*>(&chanHeader), sizeof(XTFCHANHEADER));
         if (file.gcount() != sizeof(XTFCHANHEADER)) break;
         if (chanHeader.MagicNumber != 0xFACE) break;
+        const std::streampos packetEnd = packetStart + static_cast<std::streamoff>(chanHeader.NumBytesThisRecord);
         // qDebug()<<"XTFCHAHEADER size:"<<chanHeader.NumBytesThisRecord;
         switch (chanHeader.HeaderType) {
         case 0: { // 侧扫数据
             XTFPINGHEADER xtfpingHeader{};
-            file.seekg(-static_cast<int>(sizeof(XTFCHANHEADER)), std::ios::cur);
+            file.seekg(packetStart);
             file.read(reinterpret_cast<char*>(&xtfpingHeader), sizeof(XTFPINGHEADER));
             // qDebug()<<"SoundVelocity:"<< xtfpingHeader.SoundVelocity;
+            int side = 0;   // 在选中通道中的序号：0 左舷，1 右舷
             for (int i = 0; i < header.NumberOfSonarChannels && i < 6; i++) {
                 XTFPINGCHANHEADER xtfpingChanHeader{};
                 file.read(reinterpret_cast<char*>(&xtfpingChanHeader), sizeof(XTFPINGCHANHEADER));
@@ -62,29 +413,40 @@ void xtfparse::parseXtfHeader(const QString &filePath, QVector<std::vector<uint8
 
                 // qDebug()<<"NumSamples: "<<xtfpingChanHeader.NumSamples;
 
-                //提取并保存每个 ping 的参数
-                PingMeta meta = extractPingMeta(xtfpingHeader, xtfpingChanHeader);
-                pingMetaList.append(meta);
+                const int numSamples = xtfpingChanHeader.NumSamples;
+                const int bytesPerSample = qMax<int>(1, header.ChanInfo[i].BytesPerSample);
+                const std::streamoff sampleBytes = static_cast<std::streamoff>(numSamples) * bytesPerSample;
 
-                std::vector<uint8_t> rawData(xtfpingChanHeader.NumSamples, 0);
+                // 未选中的通道直接跳过样本，不读入内存
+                if (!XtfMappedReader::isChannelSelected(channelMask, i)) {
+                    file.seekg(sampleBytes, std::ios::cur);
+                    continue;
+                }
+
+                //提取并保存每个 ping 的参数（取第一个选中通道，与左舷行对齐）
+                if (side == 0) metaTable.append(extractPingMeta(xtfpingHeader, xtfpingChanHeader));
 
-                if (header.ChanInfo[i].BytesPerSample == 1) {
-                    file.read(reinterpret_cast<char*>(rawData.data()), xtfpingChanHeader.NumSamples);
-                } else {
-                    std::vector<int16_t> rawSamples(xtfpingChanHeader.NumSamples);
-                    file.read(reinterpret_cast<char*>(rawSamples.data()), xtfpingChanHeader.NumSamples * sizeof(int16_t));
-                    for (int k = 0; k < (int)xtfpingChanHeader.NumSamples; ++k) {
-                        rawData[k] = 255 * rawSamples[k] / 32768;
-                    }
+                if (side > 1) {     // 只保留左右舷
+                    file.seekg(sampleBytes, std::ios::cur);
+                    continue;
                 }
 
-                if (i == 0) portData.append(rawData);       // 左舷
-                else if (i == 1) starboardData.append(rawData); // 右舷
+                rawSamples.resize(static_cast<size_t>(sampleBytes));
+                file.read(reinterpret_cast<char*>(rawSamples.data()), sampleBytes);
+
+                uint8_t* rawData = (side == 0 ? portData : starboardData).appendRow(numSamples);   // 左舷 / 右舷
+                converter.convert(rawSamples.data(), bytesPerSample, rawData, numSamples);
+                if (uint8_t* nativeRow = appendNativeRow(nativeData, side, numSamples)) {
+                    PingDecoder::copyNativeSamples(rawSamples.data(), bytesPerSample, nativeRow,
+                                                   nativeData.bytesPerSample, numSamples);
+                }
+                ++side;
             }
+            file.seekg(packetEnd);     // 跳过包尾的填充
             break;
         }
         default:
-            file.seekg(chanHeader.NumBytesThisRecord, std::ios::cur);
+            file.seekg(packetEnd);
         }
     }
 }
@@ -117,5 +479,28 @@ PingMeta xtfparse::extractPingMeta(const XTFPINGHEADER &pingHeader, const XTFPIN
         meta.slantRange = slantRangeInt;
     }
 
+    // ping 时间：日期无效时为 0
+    const QDate date(pingHeader.Year, pingHeader.Month, pingHeader.Day);
+    const QTime clock(pingHeader.Hour, pingHeader.Minute, pingHeader.Second, pingHeader.HSeconds * 10);
+    if (date.isValid() && clock.isValid())
+        meta.time = QDateTime(date, clock, Qt::UTC).toMSecsSinceEpoch() / 1000.0;
+
+    // 位置、航向、速度：优先用传感器（拖鱼）的值，没有时用船的值
+    if (pingHeader.SensorXcoordinate != 0.0 || pingHeader.SensorYcoordinate != 0.0) {
+        meta.x = pingHeader.SensorXcoordinate;
+        meta.y = pingHeader.SensorYcoordinate;
+    } else {
+        meta.x = pingHeader.ShipXcoordinate;
+        meta.y = pingHeader.ShipYcoordinate;
+    }
+    meta.heading = pingHeader.SensorHeading != 0.0f ? pingHeader.SensorHeading : pingHeader.ShipGyro;
+    meta.speed = pingHeader.SensorSpeed > 0.0f ? pingHeader.SensorSpeed : pingHeader.ShipSpeed;
+
+    // 高度计读数，主高度无效时用辅助高度
+    if (pingHeader.SensorPrimaryAltitude > 0.0f)
+        meta.altitude = pingHeader.SensorPrimaryAltitude;
+    else if (pingHeader.SensorAuxAltitude > 0.0f)
+        meta.altitude = pingHeader.SensorAuxAltitude;
+
     return meta;
 }
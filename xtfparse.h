@@ -5,29 +5,117 @@
 #include "xtf.h"
 #include <QVector>
 #include <vector>
+#include <functional>
+#include <atomic>
+#include "pingmatrix.h"
+#include "sampleconverter.h"
+#include "pingmeta.h"
 
-struct PingMeta {
-    int numSamples;         // 样点数
-    double timeDuration;    // 总采样时长 (s)
-    double sampleInterval;  // 每个样点的采样间隔 (s)
-    double soundVelocity;   // 声速 (m/s)，可能已经除过2
-    double slantRange;      // 最大斜距 (m)
-};
+struct PingView;
+struct PingRowTargets;
+class PingDecoder;
+class XtfMappedReader;
+
+// 流式解析的回调：每解出一批 ping 调用一次，bytesDone/bytesTotal 用于显示进度。
+// 未开启 setKeepNativeSamples 时 nativeBatch 为空。metaBatch 每个 ping 一行（取第一个选中通道的参数）。
+// 返回 false 表示取消解析
+using PingBatchCallback = std::function<bool(PingMatrix& portBatch, PingMatrix& starboardBatch,
+                                             NativeSamples& nativeBatch, PingMetaTable& metaBatch,
+                                             qint64 bytesDone, qint64 bytesTotal)>;
 
 class xtfparse : public QObject
 {
     Q_OBJECT
 public:
+    // 读取方式：流式读取 / 内存映射
+    enum ReadMode {
+        StreamRead,
+        MappedRead
+    };
+
     explicit xtfparse(QObject* parent = nullptr);
     ~xtfparse();
 
-    // 解析 XTF 文件头和侧扫数据，返回左右舷数据
-    void parseXtfHeader(const QString &filePath, QVector<std::vector<uint8_t>> &portData, QVector<std::vector<uint8_t>> &starboardData);
+    void setReadMode(ReadMode mode) { readMode = mode; }
+    ReadMode currentReadMode() const { return readMode; }
+
+    // 内存映射模式下并行解析使用的线程数，1 为单线程，默认等于 CPU 核数
+    void setThreadCount(int count);
+    int threadCount() const { return parseThreads; }
+
+    // 通道掩码：第 i 位为 1 表示解码第 i 个通道，未选中通道的样本直接跳过。
+    // 选中的第一、二个通道作为左右舷，例如双频文件只看高频时设为 0b1100
+    void setChannelMask(quint64 mask) { channelMask = mask; }
+    quint64 currentChannelMask() const { return channelMask; }
+
+    // 取消标志（可为空），可在其他线程置位：扫描包头、预览解码和流式解析检查到后尽快返回 false
+    void setCancelFlag(const std::atomic<bool>* flag) { cancelFlag = flag; }
+
+    // 16/32 位样本转换为 8 位显示数据的映射方式，默认与原来的 255*x/32768 一致
+    void setSampleMapping(const SampleMapping& mapping) { converter = SampleConverter(mapping); }
+    const SampleMapping& sampleMapping() const { return converter.mapping(); }
+
+    // 是否同时保留 16/32 位原始样本，之后可以换映射重新生成显示数据而不必重新解析
+    void setKeepNativeSamples(bool keep) { keepNative = keep; }
+    bool keepNativeSamples() const { return keepNative; }
+
+    // 解析 XTF 文件头和侧扫数据，返回左右舷数据。
+    // native 不为空且开启了 setKeepNativeSamples 时，同时返回原始位深样本
+    void parseXtfHeader(const QString &filePath, PingMatrix &portData, PingMatrix &starboardData,
+                        NativeSamples *native = nullptr);
+
+    // 一次解码通道掩码选中的所有声呐通道（包括双频系统的 CHAN_PORT_HIGH_FREQ / CHAN_STBD_HIGH_FREQ），
+    // channels[i] 为第 i 个选中的通道。只支持内存映射读取，失败返回 false
+    bool parseAllChannels(const QString &filePath, QVector<PingMatrix> &channels, NativeSamples *native = nullptr);
+
+    // 跟随模式：流式解析读到文件尾后不结束，每隔 intervalMs 检查文件是否变大，
+    // 只解码新追加的完整数据包，直到回调返回 false
+    void setFollowGrowth(bool follow, int intervalMs = 500) { followGrowth = follow; followInterval = qMax(10, intervalMs); }
+    bool isFollowingGrowth() const { return followGrowth; }
+
+    // 流式解析：边扫描边解码，第一批 firstBatchSize 个 ping 尽快交出，之后每 batchSize 个交一次，
+    // 每批按 ping 切块并行解码。
+    // 跟随模式下等待期间每个间隔用空批次调用一次回调，以便取消。
+    // 完整解析完返回 true，打开失败或被回调取消返回 false
+    bool parseXtfStreaming(const QString &filePath, const PingBatchCallback &onBatch,
+                           int firstBatchSize = 256, int batchSize = 2048);
+
+    // 快速预览：用包索引（没有有效索引文件时并行扫描包头，并写出索引供之后的完整读取使用）
+    // 每隔 stride 个 ping 解码一个，横向每 stride 个样本取最大值，纵横比例与完整数据相同。
+    // stride 取使预览不超过 maxPings 行的最小值，通过 strideOut 返回。失败返回 false
+    bool parsePreview(const QString &filePath, PingMatrix &portPreview, PingMatrix &starboardPreview,
+                      int maxPings = 4096, int *strideOut = nullptr);
 
     PingMeta extractPingMeta(const XTFPINGHEADER& pingHeader, const XTFPINGCHANHEADER& chanHeader);
 
+    // 最近一次解析得到的 ping 参数，每个 ping 一行（取第一个选中通道），与左舷行号对齐；每次解析前清空
+    const PingMetaTable& pingMeta() const { return metaTable; }
+
 private:
-    QVector<PingMeta> pingMetaList;   // 存很多 ping 的参数
+    // 流式读取：逐包 ifstream 读取
+    void parseStream(const QString &filePath, PingMatrix &portData, PingMatrix &starboardData, NativeSamples *native);
+    // 内存映射读取：一次扫描，直接从映射区取样本，解码前 channelLimit 个通道（-1 为全部），失败返回 false
+    bool parseMapped(const QString &filePath, QVector<PingMatrix> &channels, int channelLimit, NativeSamples *native);
+    // 解码 [first, end) 范围内的 ping，追加到 channels（依次为前几个选中通道）和 native（只保留左右舷），
+    // 参数追加到 meta 并与 channels[0] 的行对齐。先分配好各行，再按 ping 切块并行解码
+    void decodePings(const XtfMappedReader &reader, int first, int end, const PingDecoder &decoder,
+                     const QVector<PingMatrix*> &channels, NativeSamples &native, PingMetaTable &meta);
+    // 提取前 metaChannels 个通道的参数并用 decoder 解码样本，返回提取参数的通道数
+    int decodePing(const PingView &ping, const PingDecoder &decoder, const PingRowTargets &rows,
+                   int metaChannels, PingMeta *metas);
+    // 按选中通道的位宽决定要保留的原始位深（左右舷中较宽者），不保留时为 0
+    int nativeBytesFor(const QVector<int> &widths) const;
+    bool isCancelled() const { return cancelFlag && cancelFlag->load(); }
+
+    ReadMode readMode = MappedRead;
+    int parseThreads = 1;
+    SampleConverter converter;
+    bool keepNative = false;
+    quint64 channelMask = ~0ULL;     // 默认全选
+    bool followGrowth = false;
+    int followInterval = 500;        // 跟随模式检查文件大小的间隔 (ms)
+    const std::atomic<bool>* cancelFlag = nullptr;
+    PingMetaTable metaTable;   // 每个 ping 的参数
 
 };
 